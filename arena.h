@@ -0,0 +1,172 @@
+// Copyright (c) 2013 Craig Henderson
+// Part of the Data Processing Library
+// https://github.com/cdmh/dataproc
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cdmh {
+namespace data_processing {
+namespace detail {
+
+// a block allocator for values that are owned by a dataset. memory is
+// allocated from large blocks and is only released when the arena is
+// cleared or destroyed, so allocations are cheap and never move
+class arena
+{
+  public:
+    explicit arena(size_t block_size=64*1024)
+      : block_size_(block_size),
+        next_(nullptr),
+        available_(0)
+    { }
+
+    // allocate memory, this is safe to call from many threads
+    char *allocate(size_t size)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (size > available_)
+        {
+            // large allocations have a block of their own, so the
+            // rest of the current block is not wasted
+            if (size > block_size_ / 4)
+            {
+                blocks_.emplace_back(new char[size]);
+                return blocks_.back().get();
+            }
+
+            blocks_.emplace_back(new char[block_size_]);
+            next_      = blocks_.back().get();
+            available_ = block_size_;
+        }
+
+        char *result = next_;
+        next_      += size;
+        available_ -= size;
+        return result;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        blocks_.clear();
+        next_      = nullptr;
+        available_ = 0;
+    }
+
+  private:
+    arena(arena const &);
+    arena &operator=(arena const &);
+
+  private:
+    std::mutex                           mutex_;
+    size_t                         const block_size_;
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char                                *next_;
+    size_t                               available_;
+};
+
+// a vector that stores its elements in segments that double in size, so
+// that growing the vector allocates a segment rather than copying the
+// elements, and elements never move once they are added. element i is in
+// segment floor_log2(i + first_segment) - first_segment_bits
+template<typename T>
+class segmented_vector
+{
+  public:
+    segmented_vector() : size_(0), capacity_(0)
+    { }
+
+    segmented_vector(segmented_vector const &other);
+    segmented_vector(segmented_vector &&other);
+    segmented_vector &operator=(segmented_vector other)
+    {
+        swap(other);
+        return *this;
+    }
+
+    T       &operator[](size_t index)       { return const_cast<T &>(static_cast<segmented_vector const &>(*this)[index]); }
+    T const &operator[](size_t index) const
+    {
+        size_t const position = index + first_segment;
+        unsigned const bits = floor_log2(position);
+        return segments_[bits - first_segment_bits][position - (size_t(1) << bits)];
+    }
+
+    // the elements of a segment, to iterate without indexing each element
+    T      const *segment(size_t n)      const { return segments_[n].get(); }
+    size_t const  segment_size(size_t n) const { return size_t(1) << (first_segment_bits + n); }
+
+    size_t const capacity() const { return capacity_;  }
+    bool   const empty()    const { return size_ == 0; }
+    size_t const size()     const { return size_;      }
+
+    // the segments are kept, so the storage is reused as the vector
+    // grows again
+    void clear()
+    {
+        size_ = 0;
+    }
+
+    void push_back(T const &value)
+    {
+        if (size_ == capacity_)
+            add_segment();
+        (*this)[size_++] = value;
+    }
+
+    void reserve(size_t size)
+    {
+        while (capacity_ < size)
+            add_segment();
+    }
+
+    void swap(segmented_vector &other)
+    {
+        segments_.swap(other.segments_);
+        std::swap(size_, other.size_);
+        std::swap(capacity_, other.capacity_);
+    }
+
+  private:
+    void add_segment()
+    {
+        size_t const size = size_t(1) << (first_segment_bits + segments_.size());
+        segments_.emplace_back(new T[size]);
+        capacity_ += size;
+    }
+
+  private:
+    static unsigned const first_segment_bits = 4;
+    static size_t   const first_segment      = size_t(1) << first_segment_bits;
+
+    std::vector<std::unique_ptr<T[]>> segments_;
+    size_t                            size_;
+    size_t                            capacity_;
+};
+
+template<typename T>
+inline segmented_vector<T>::segmented_vector(segmented_vector const &other)
+  : size_(0), capacity_(0)
+{
+    reserve(other.size_);
+    for (size_t loop=0; loop<other.size_; ++loop)
+        push_back(other[loop]);
+}
+
+template<typename T>
+inline segmented_vector<T>::segmented_vector(segmented_vector &&other)
+  : segments_(std::move(other.segments_)),
+    size_(other.size_),
+    capacity_(other.capacity_)
+{
+    other.size_     = 0;
+    other.capacity_ = 0;
+}
+
+}   // namespace detail
+}   // namespace data_processing
+}   // namespace cdmh
@@ -0,0 +1,104 @@
+// Copyright (c) 2013 Craig Henderson
+// Part of the Data Processing Library
+// https://github.com/cdmh/dataproc
+
+// Bitmaps of 64 bit words, which hold a bit for each row of a column that
+// isn't null. Bit n of a bitmap is bit n % 64 of word n / 64. The set
+// bits are counted with the kernel that reductions.h selects for the
+// processor.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace cdmh {
+namespace data_processing {
+namespace detail {
+
+// append a bit to a bitmap of 64 bit words that holds 'size' bits
+inline void push_bit(std::vector<std::uint64_t> &bits, size_t size, bool value)
+{
+    if (size % 64 == 0)
+        bits.push_back(0);
+    if (value)
+        bits.back() |= std::uint64_t(1) << (size % 64);
+}
+
+// returns a bit of a bitmap of 64 bit words
+inline bool const test_bit(std::vector<std::uint64_t> const &bits, size_t index)
+{
+    return ((bits[index / 64] >> (index % 64)) & 1) != 0;
+}
+
+// append a bitmap of 'other_size' bits to a bitmap of 'size' bits
+inline void append_bits(std::vector<std::uint64_t> &bits, size_t size, std::vector<std::uint64_t> const &other, size_t other_size)
+{
+    unsigned const shift = size % 64;
+    if (shift == 0)
+    {
+        bits.insert(bits.end(), other.begin(), other.end());
+        return;
+    }
+
+    // each word of the other bitmap straddles two words
+    for (auto word : other)
+    {
+        bits.back() |= word << shift;
+        bits.push_back(word >> (64 - shift));
+    }
+    bits.resize((size + other_size + 63) / 64);
+}
+
+inline size_t const count_set_bits_scalar(std::uint64_t const *bits, size_t words)
+{
+    size_t count = 0;
+    for (size_t word=0; word<words; ++word)
+        count += popcount(bits[word]);
+    return count;
+}
+
+#if defined(DATA_PROCESSING_SIMD_DISPATCH)
+// counts the bits of each nibble with a table lookup, and adds the
+// counts of the bytes of each 64 bit lane with a sum of absolute
+// differences
+DATA_PROCESSING_TARGET("avx2")
+inline size_t const count_set_bits_avx2(std::uint64_t const *bits, size_t words)
+{
+    __m256i const table = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    __m256i const low_nibbles = _mm256_set1_epi8(0x0f);
+
+    __m256i total = _mm256_setzero_si256();
+    size_t word = 0;
+    for (; word + 4 <= words; word += 4)
+    {
+        __m256i const value  = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(bits + word));
+        __m256i const low    = _mm256_shuffle_epi8(table, _mm256_and_si256(value, low_nibbles));
+        __m256i const high   = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(value, 4), low_nibbles));
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256()));
+    }
+
+    std::uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), total);
+    return size_t(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + count_set_bits_scalar(bits + word, words - word);
+}
+#endif
+
+// returns the number of bits set in a bitmap of 64 bit words. the
+// AVX2 kernel is used by processors with AVX-512
+inline size_t const count_set_bits(std::uint64_t const *bits, size_t words, simd_level level=supported_simd_level())
+{
+#if defined(DATA_PROCESSING_SIMD_DISPATCH)
+    if (std::min(level, supported_simd_level()) >= avx2_kernels)
+        return count_set_bits_avx2(bits, words);
+#else
+    (void)level;
+#endif
+    return count_set_bits_scalar(bits, words);
+}
+
+}   // namespace detail
+}   // namespace data_processing
+}   // namespace cdmh
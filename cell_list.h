@@ -0,0 +1,374 @@
+// Copyright (c) 2013 Craig Henderson
+// Part of the Data Processing Library
+// https://github.com/cdmh/dataproc
+
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+namespace cdmh {
+namespace data_processing {
+namespace detail {
+
+// a list of cells stored compactly. the cells of a column refer to the
+// attached buffer, so each cell is stored as a 32 bit offset from a base
+// address and a 32 bit length, which is half the size of a string_view.
+// the few values that are elsewhere, such as unescaped values in the
+// arena, are held in a separate list. if the values span 4GB or more,
+// the list is widened to store a string_view for each cell. the narrow
+// cells are stored in segments, so the list grows without copying them.
+// a list can also be a view of narrow cells in other memory, such as a
+// memory mapped snapshot, which is copied if the list is changed
+template<typename Cell>
+class cell_list
+{
+  public:
+    class const_iterator;
+
+    cell_list() : base_(nullptr), extent_(0), wide_(false), view_(nullptr), view_size_(0)
+    { }
+
+    Cell           const operator[](size_t index) const;
+    const_iterator const begin()                  const { return const_iterator(this, 0);       }
+    const_iterator const end()                    const { return const_iterator(this, size());  }
+    bool           const empty()                  const { return size() == 0;                   }
+    bool           const is_wide()                const { return wide_;                         }
+    size_t         const size()                   const { return wide_? wide_cells_.size() : (view_? view_size_ : cells_.size()); }
+
+    void append(cell_list const &other);
+    void attach_view(char const *base, size_t extent, std::uint32_t const *cells, size_t size);
+    void clear();
+    void push_back(string_view const &value);
+    void reserve(size_t size);
+    void set(size_t index, string_view const &value);
+
+  private:
+    struct narrow_cell
+    {
+        std::uint32_t offset;
+        std::uint32_t length;
+    };
+
+    // the length of a cell that is an index into the list of other values
+    static std::uint32_t const other_value = 0xffffffff;
+
+    Cell               const  cell(narrow_cell const &cell) const;
+    narrow_cell        const &narrow(size_t index)          const { return view_? view_[index] : cells_[index]; }
+    static bool        const  in_range(size_t extent);
+    void own();
+    bool const move_base(char const *base);
+    void rebase(char const *base);
+    void widen();
+
+  private:
+    char const                    *base_;
+    size_t                         extent_;         // the end of the furthest cell from the base
+    bool                           wide_;
+    segmented_vector<narrow_cell>  cells_;
+    std::vector<string_view>       other_values_;
+    std::vector<string_view>       wide_cells_;
+    narrow_cell             const *view_;
+    size_t                         view_size_;
+};
+
+template<typename Cell>
+class cell_list<Cell>::const_iterator
+{
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef Cell                      value_type;
+    typedef std::ptrdiff_t            difference_type;
+    typedef Cell const               *pointer;
+    typedef Cell const                reference;
+
+    const_iterator() : list_(nullptr), index_(0), cell_(nullptr), segment_end_(nullptr), segment_(0)
+    { }
+
+    // narrow cells are read a segment at a time from the start of the list
+    const_iterator(cell_list const *list, size_t index)
+      : list_(list), index_(index), cell_(nullptr), segment_end_(nullptr), segment_(0)
+    {
+        if (index == 0  &&  !list->wide_  &&  !list->empty())
+            load_segment();
+    }
+
+    Cell const      operator*()                            const { return cell_? list_->cell(*cell_) : (*list_)[index_]; }
+    const_iterator  operator++(int)                              { auto it = *this; ++*this; return it; }
+    bool const      operator==(const_iterator const &other) const { return index_ == other.index_; }
+    bool const      operator!=(const_iterator const &other) const { return index_ != other.index_; }
+
+    const_iterator &operator++()
+    {
+        ++index_;
+        if (cell_  &&  ++cell_ == segment_end_)
+        {
+            ++segment_;
+            if (index_ < list_->size())
+                load_segment();
+        }
+        return *this;
+    }
+
+  private:
+    void load_segment()
+    {
+        if (list_->view_)
+        {
+            cell_        = list_->view_;
+            segment_end_ = cell_ + list_->view_size_;
+            return;
+        }
+        cell_        = list_->cells_.segment(segment_);
+        segment_end_ = cell_ + list_->cells_.segment_size(segment_);
+    }
+
+  private:
+    cell_list   const *list_;
+    size_t             index_;
+    narrow_cell const *cell_;
+    narrow_cell const *segment_end_;
+    size_t             segment_;
+};
+
+template<typename Cell>
+inline Cell const cell_list<Cell>::operator[](size_t index) const
+{
+    if (wide_)
+        return Cell(wide_cells_[index]);
+    return cell(narrow(index));
+}
+
+template<typename Cell>
+inline Cell const cell_list<Cell>::cell(narrow_cell const &cell) const
+{
+    if (cell.length == 0)
+        return Cell(string_view(""));
+    else if (cell.length == other_value)
+        return Cell(other_values_[cell.offset]);
+    return Cell(string_view(base_ + cell.offset, base_ + cell.offset + cell.length));
+}
+
+// append the cells of another list. the offsets of the other list are
+// moved to the base of this list if the cells of both lists are within
+// 4GB, as they are when the lists refer to the same buffer
+template<typename Cell>
+inline void cell_list<Cell>::append(cell_list const &other)
+{
+    if (other.empty())
+        return;
+    else if (empty()  &&  !wide_)
+    {
+        *this = other;
+        return;
+    }
+
+    own();
+    if (other.wide_)
+        widen();
+    else if (!wide_  &&  other.base_ != nullptr)
+    {
+        if (!move_base(other.base_)  ||  !in_range(size_t(other.base_ - base_) + other.extent_))
+            widen();
+    }
+
+    if (wide_)
+    {
+        for (auto const &cell : other)
+            wide_cells_.push_back(cell.template get<string_view>());
+        return;
+    }
+
+    std::ptrdiff_t const delta = (other.base_ == nullptr)? 0 : other.base_ - base_;
+    for (size_t loop=0; loop<other.size(); ++loop)
+    {
+        auto cell = other.narrow(loop);
+        if (cell.length == other_value)
+        {
+            auto const source = cell.offset;
+            cell.offset = std::uint32_t(other_values_.size());
+            other_values_.push_back(other.other_values_[source]);
+        }
+        else if (cell.length != 0)
+            cell.offset = std::uint32_t(cell.offset + delta);
+        cells_.push_back(cell);
+    }
+    if (other.base_ != nullptr)
+        extent_ = std::max(extent_, size_t(delta) + other.extent_);
+}
+
+// refer to narrow cells in other memory, stored as pairs of a 32 bit
+// offset from 'base' and a 32 bit length. the memory must outlive the list
+template<typename Cell>
+inline void cell_list<Cell>::attach_view(char const *base, size_t extent, std::uint32_t const *cells, size_t size)
+{
+    static_assert(sizeof(narrow_cell) == 2 * sizeof(std::uint32_t), "narrow cells must be a pair of 32 bit values");
+    clear();
+    base_      = base;
+    extent_    = extent;
+    view_      = reinterpret_cast<narrow_cell const *>(cells);
+    view_size_ = size;
+}
+
+template<typename Cell>
+inline void cell_list<Cell>::clear()
+{
+    base_      = nullptr;
+    extent_    = 0;
+    wide_      = false;
+    view_      = nullptr;
+    view_size_ = 0;
+    cells_.clear();
+    other_values_.clear();
+    wide_cells_.clear();
+}
+
+// add a cell. the first value that isn't empty sets the base, and a
+// value before the base moves the base if the cells are within 4GB
+template<typename Cell>
+inline void cell_list<Cell>::push_back(string_view const &value)
+{
+    if (wide_)
+    {
+        wide_cells_.push_back(value);
+        return;
+    }
+
+    own();
+    size_t const length = value.length();
+    if (length == 0)
+    {
+        narrow_cell const cell = { 0, 0 };
+        cells_.push_back(cell);
+        return;
+    }
+
+    if (!move_base(value.begin())  ||  length >= other_value  ||  !in_range(size_t(value.begin() - base_) + length))
+    {
+        widen();
+        wide_cells_.push_back(value);
+        return;
+    }
+
+    size_t const offset = value.begin() - base_;
+    narrow_cell const cell = { std::uint32_t(offset), std::uint32_t(length) };
+    cells_.push_back(cell);
+    extent_ = std::max(extent_, offset + length);
+}
+
+template<typename Cell>
+inline void cell_list<Cell>::reserve(size_t size)
+{
+    own();
+    if (wide_)
+        wide_cells_.reserve(size);
+    else
+        cells_.reserve(size);
+}
+
+// replace the value of a cell. a value that is not within 4GB of the
+// base is held in the list of other values
+template<typename Cell>
+inline void cell_list<Cell>::set(size_t index, string_view const &value)
+{
+    if (wide_)
+    {
+        wide_cells_[index] = value;
+        return;
+    }
+
+    own();
+    size_t const length = value.length();
+    auto        &cell   = cells_[index];
+    if (length == 0)
+    {
+        cell.offset = 0;
+        cell.length = 0;
+    }
+    else if (base_ != nullptr  &&  value.begin() >= base_  &&  length < other_value  &&  size_t(value.begin() - base_) + length <= extent_)
+    {
+        cell.offset = std::uint32_t(value.begin() - base_);
+        cell.length = std::uint32_t(length);
+    }
+    else
+    {
+        cell.offset = std::uint32_t(other_values_.size());
+        cell.length = other_value;
+        other_values_.push_back(value);
+    }
+}
+
+// returns true if a cell that ends 'extent' bytes from the base can be
+// stored with a 32 bit offset
+template<typename Cell>
+inline bool const cell_list<Cell>::in_range(size_t extent)
+{
+    return extent <= std::numeric_limits<std::uint32_t>::max();
+}
+
+// set the base so that a value at 'address' is not before it, returns
+// false if the cells would not be within 4GB of the new base
+template<typename Cell>
+inline bool const cell_list<Cell>::move_base(char const *address)
+{
+    if (base_ == nullptr)
+        base_ = address;
+    else if (address < base_)
+    {
+        if (!in_range(size_t(base_ - address) + extent_))
+            return false;
+        rebase(address);
+    }
+    return true;
+}
+
+// copy the cells of a view, so that they can be changed
+template<typename Cell>
+inline void cell_list<Cell>::own()
+{
+    if (view_ == nullptr)
+        return;
+
+    cells_.clear();
+    cells_.reserve(view_size_);
+    for (size_t loop=0; loop<view_size_; ++loop)
+        cells_.push_back(view_[loop]);
+    view_      = nullptr;
+    view_size_ = 0;
+}
+
+// move the base to an earlier address, adjusting the offsets of the cells
+template<typename Cell>
+inline void cell_list<Cell>::rebase(char const *base)
+{
+    assert(base < base_);
+    std::uint32_t const delta = std::uint32_t(base_ - base);
+    for (size_t loop=0; loop<cells_.size(); ++loop)
+    {
+        auto &cell = cells_[loop];
+        if (cell.length != 0  &&  cell.length != other_value)
+            cell.offset += delta;
+    }
+    extent_ += delta;
+    base_    = base;
+}
+
+// store a string_view for each cell, for values that span 4GB or more
+template<typename Cell>
+inline void cell_list<Cell>::widen()
+{
+    own();
+    wide_cells_.reserve(cells_.capacity());
+    for (size_t loop=0; loop<cells_.size(); ++loop)
+        wide_cells_.push_back((*this)[loop].template get<string_view>());
+
+    segmented_vector<narrow_cell>().swap(cells_);
+    std::vector<string_view>().swap(other_values_);
+    wide_ = true;
+}
+
+}   // namespace detail
+}   // namespace data_processing
+}   // namespace cdmh
@@ -0,0 +1,402 @@
+// Copyright (c) 2013 Craig Henderson
+// Part of the Data Processing Library
+// https://github.com/cdmh/dataproc
+
+// Reading of gzip and zstd compressed CSV files. A thread decompresses
+// the file into a ring of buffers, each holding whole records, while the
+// records of the previous buffer are read into a dataset, so that
+// decompression overlaps with parsing.
+//
+// Define DATA_PROCESSING_USE_ZLIB to read gzip files with zlib, and
+// DATA_PROCESSING_USE_ZSTD to read zstd files with libzstd.
+
+#pragma once
+
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifdef DATA_PROCESSING_USE_ZLIB
+#   include <zlib.h>
+#endif
+
+#ifdef DATA_PROCESSING_USE_ZSTD
+#   include <cstdio>
+#   include <zstd.h>
+#endif
+
+namespace cdmh {
+namespace data_processing {
+namespace detail {
+
+// a source of decompressed data
+class decompressor
+{
+  public:
+    virtual ~decompressor() { }
+
+    // read up to 'size' bytes, returns 0 at the end of the data
+    virtual size_t const read(char *buffer, size_t size) = 0;
+};
+
+#ifdef DATA_PROCESSING_USE_ZLIB
+// gzip and zlib files, including files of several gzip members
+class gzip_decompressor : public decompressor
+{
+  public:
+    explicit gzip_decompressor(char const *filename)
+      : file_(gzopen(filename, "rb"))
+    {
+        if (file_ == nullptr)
+            throw std::runtime_error("Failed to open compressed file");
+        gzbuffer(file_, 256 * 1024);
+    }
+
+    ~gzip_decompressor()
+    {
+        gzclose(file_);
+    }
+
+    // zlib reports a truncated file as an error after returning 0, so the
+    // error is checked at the end of the data
+    size_t const read(char *buffer, size_t size)
+    {
+        int const length = gzread(file_, buffer, (unsigned)std::min<size_t>(size, INT_MAX));
+        if (length < 0)
+            throw std::runtime_error("Failed to decompress file");
+        else if (length == 0)
+        {
+            int error = Z_OK;
+            gzerror(file_, &error);
+            if (error == Z_BUF_ERROR)
+                throw std::runtime_error("Compressed file is truncated");
+            else if (error != Z_OK)
+                throw std::runtime_error("Failed to decompress file");
+        }
+        return length;
+    }
+
+  private:
+    gzip_decompressor(gzip_decompressor const &);
+    gzip_decompressor &operator=(gzip_decompressor const &);
+
+  private:
+    gzFile file_;
+};
+#endif
+
+#ifdef DATA_PROCESSING_USE_ZSTD
+// zstd files, including files of several frames. the file and the
+// context are owned by unique_ptrs, so neither leaks if the other can't
+// be created
+class zstd_decompressor : public decompressor
+{
+  public:
+    explicit zstd_decompressor(char const *filename)
+      : file_(fopen(filename, "rb"), &fclose),
+        context_(nullptr, &ZSTD_freeDCtx),
+        input_(ZSTD_DStreamInSize()),
+        position_(0),
+        length_(0),
+        end_of_file_(false),
+        in_frame_(false)
+    {
+        if (!file_)
+            throw std::runtime_error("Failed to open compressed file");
+        context_.reset(ZSTD_createDCtx());
+        if (!context_)
+            throw std::runtime_error("Failed to create decompression context");
+    }
+
+    // at the end of the file, the decoder may still hold data that didn't
+    // fit in the last buffer, so it is called without input until it has
+    // no more data. the file is truncated if the decoder is then part of
+    // the way through a frame, which it is until a call returns 0
+    size_t const read(char *buffer, size_t size)
+    {
+        ZSTD_outBuffer output = { buffer, size, 0 };
+        while (output.pos == 0)
+        {
+            if (position_ == length_  &&  !end_of_file_)
+            {
+                length_      = fread(&input_[0], 1, input_.size(), file_.get());
+                position_    = 0;
+                end_of_file_ = (length_ == 0);
+            }
+
+            ZSTD_inBuffer input = { &input_[0], length_, position_ };
+            size_t const result = ZSTD_decompressStream(context_.get(), &output, &input);
+            if (ZSTD_isError(result))
+                throw std::runtime_error("Failed to decompress file");
+            if (input.pos != position_  ||  output.pos != 0)
+                in_frame_ = (result != 0);
+            position_ = input.pos;
+
+            if (end_of_file_  &&  output.pos == 0)
+            {
+                if (in_frame_)
+                    throw std::runtime_error("Compressed file is truncated");
+                break;
+            }
+        }
+        return output.pos;
+    }
+
+  private:
+    zstd_decompressor(zstd_decompressor const &);
+    zstd_decompressor &operator=(zstd_decompressor const &);
+
+  private:
+    std::unique_ptr<FILE, int (*)(FILE *)>                file_;
+    std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx *)>   context_;
+    std::vector<char>                                     input_;
+    size_t                                                position_;
+    size_t                                                length_;
+    bool                                                  end_of_file_;
+    bool                                                  in_frame_;
+};
+#endif
+
+// create a decompressor for a file, chosen by the file extension
+inline std::unique_ptr<decompressor> open_decompressor(std::string const &filename)
+{
+    auto const ends_with = [&filename](char const *extension) {
+        size_t const length = strlen(extension);
+        return filename.length() >= length  &&  filename.compare(filename.length() - length, length, extension) == 0;
+    };
+
+#ifdef DATA_PROCESSING_USE_ZSTD
+    if (ends_with(".zst"))
+        return std::unique_ptr<decompressor>(new zstd_decompressor(filename.c_str()));
+#endif
+#ifdef DATA_PROCESSING_USE_ZLIB
+    if (ends_with(".gz"))
+        return std::unique_ptr<decompressor>(new gzip_decompressor(filename.c_str()));
+#endif
+    throw std::runtime_error("Unsupported compressed file type");
+}
+
+// returns the end of the last complete record in a buffer that starts
+// at a record boundary, or 'begin' if there is no complete record
+template<typename Dialect>
+inline char const *last_record_end(char const *begin, char const *end)
+{
+    basic_structural_scanner<Dialect> scanner(end);
+    char const *last = begin;
+    bool in_quotes = false;
+    for (auto it=begin; it != end; ++it)
+    {
+        it = in_quotes? scanner.find_quote(it) : scanner.find_line_end_or_quote(it);
+        if (it == end)
+            break;
+        else if (*it == Dialect::quote)
+            in_quotes = !in_quotes;
+        else
+            last = it + 1;
+    }
+    return last;
+}
+
+}   // namespace detail
+
+// reads a compressed CSV file as a sequence of datasets, one for each
+// block of decompressed records. a thread decompresses the file ahead of
+// the reader into a ring of buffers, and each buffer is returned to the
+// ring when the next group is read, so memory use is bounded by the
+// block size and the number of buffers
+template<typename Dialect>
+class basic_compressed_reader
+{
+  public:
+    explicit basic_compressed_reader(std::string const &filename, size_t block_size=4*1024*1024, unsigned buffer_count=4);
+    ~basic_compressed_reader();
+    basic_compressed_reader(basic_compressed_reader const &)            = delete;
+    basic_compressed_reader &operator=(basic_compressed_reader const &) = delete;
+
+    std::uint64_t   const  first_row() const { return first_row_; }
+    dataset         const &group()     const { return group_;     }
+    bool            const  next();
+
+  private:
+    void decompress();
+
+  private:
+    std::unique_ptr<detail::decompressor>  source_;
+    size_t                           const block_size_;
+    dataset                                group_;
+    std::string                            header_;
+    std::vector<char>                      current_;
+    std::uint64_t                          first_row_;
+
+    // buffers are passed between the decompression thread and the
+    // reader through the free and filled queues
+    std::mutex                             mutex_;
+    std::condition_variable                ready_;
+    std::deque<std::vector<char>>          free_;
+    std::deque<std::vector<char>>          filled_;
+    bool                                   finished_;
+    bool                                   stopping_;
+    std::exception_ptr                     error_;
+    std::thread                            thread_;
+};
+
+typedef basic_compressed_reader<csv_dialect> compressed_reader;
+
+template<typename Dialect>
+inline basic_compressed_reader<Dialect>::basic_compressed_reader(std::string const &filename, size_t block_size, unsigned buffer_count)
+  : source_(detail::open_decompressor(filename)),
+    block_size_(block_size),
+    first_row_(0),
+    free_(std::max(2U, buffer_count)),
+    finished_(false),
+    stopping_(false)
+{
+    assert(block_size > 0);
+    thread_ = std::thread([this]() { decompress(); });
+}
+
+template<typename Dialect>
+inline basic_compressed_reader<Dialect>::~basic_compressed_reader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+    thread_.join();
+}
+
+// read the next block of records, returns false if there are no more
+// records. column types are inferred from the values in the block alone
+template<typename Dialect>
+inline bool const basic_compressed_reader<Dialect>::next()
+{
+    // a block of blank lines has no rows, so blocks are read until one
+    // has rows or there are no more
+    do
+    {
+        first_row_ += group_.rows();
+        group_.erase_rows();
+
+        // the cells of the group refer to the current buffer, so it is not
+        // returned to the ring until the group has been cleared
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!current_.empty())
+            {
+                free_.push_back(std::move(current_));
+                current_.clear();
+                ready_.notify_all();
+            }
+
+            ready_.wait(lock, [this]() { return !filled_.empty()  ||  finished_; });
+            if (filled_.empty())
+            {
+                if (error_)
+                    std::rethrow_exception(error_);
+                return false;
+            }
+            current_ = std::move(filled_.front());
+            filled_.pop_front();
+        }
+        ready_.notify_all();
+
+        char const *it        = current_.data();
+        char const *const end = it + current_.size();
+        if (!group_.is_attached())
+        {
+            // the column names must outlive the first buffer, so the header
+            // record is copied
+            detail::basic_structural_scanner<Dialect> scanner(end);
+            detail::skip_blank<Dialect>(it, end);
+            auto const header_end = detail::find_record_end(scanner, it, end);
+            header_.assign(it, header_end);
+            it = header_end;
+
+            char const *header = header_.data();
+            detail::basic_structural_scanner<Dialect> header_scanner(header + header_.size());
+            group_.attach_header(header_scanner, header, header + header_.size());
+        }
+
+        detail::basic_structural_scanner<Dialect> scanner(end);
+        group_.attach_records(scanner, it, end, 0);
+    } while (group_.rows() == 0);
+    return true;
+}
+
+// the decompression thread. each buffer is filled with whole records,
+// and the partial record at the end of the decompressed data is carried
+// to the start of the next buffer
+template<typename Dialect>
+inline void basic_compressed_reader<Dialect>::decompress()
+{
+    try
+    {
+        std::vector<char> carry;
+        bool at_end = false;
+        while (!at_end)
+        {
+            std::vector<char> buffer;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                ready_.wait(lock, [this]() { return !free_.empty()  ||  stopping_; });
+                if (stopping_)
+                    return;
+                buffer = std::move(free_.front());
+                free_.pop_front();
+            }
+
+            buffer.swap(carry);
+            carry.clear();
+
+            // fill the buffer, growing it if a single record is larger
+            // than the block
+            size_t capacity = std::max(block_size_, buffer.size() * 2);
+            char const *record_end = nullptr;
+            for (;;)
+            {
+                size_t size = buffer.size();
+                buffer.resize(capacity);
+                while (size < capacity)
+                {
+                    size_t const length = source_->read(&buffer[size], capacity - size);
+                    if (length == 0)
+                    {
+                        at_end = true;
+                        break;
+                    }
+                    size += length;
+                }
+                buffer.resize(size);
+
+                record_end = at_end? buffer.data() + size : detail::last_record_end<Dialect>(buffer.data(), buffer.data() + size);
+                if (at_end  ||  record_end != buffer.data())
+                    break;
+                capacity *= 2;
+            }
+
+            carry.assign(record_end, (char const *)buffer.data() + buffer.size());
+            buffer.resize(record_end - buffer.data());
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            filled_.push_back(std::move(buffer));
+            ready_.notify_all();
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+    ready_.notify_all();
+}
+
+}   // namespace data_processing
+}   // namespace cdmh
@@ -6,21 +6,64 @@
 
 // standard header files
 #include <cstdint>          // std::uint8_t
+#include <algorithm>        // std::min, std::max
 #include <vector>
 #include <iosfwd>           // basic_ostream
 #include <functional>       // std::function
+#include <thread>
+#include <mutex>
+#include <memory>           // std::unique_ptr
+#include <unordered_map>
 #include <locale>
 #include <cassert>
+#include <stdexcept>        // std::out_of_range
+#include <type_traits>      // std::is_arithmetic
 
 // project "system" header files
 #include "memmap.h"
 
 #include "data_processing.detail.h"
 
+namespace {
+
+static cdmh::data_processing::type_mask_t const string_type  = 1;
+static cdmh::data_processing::type_mask_t const double_type  = 1 << 1;
+static cdmh::data_processing::type_mask_t const integer_type = 1 << 2;
+static cdmh::data_processing::type_mask_t const null_type    = 1 << 3;
+
+}   // anonymous namespace
+
+// project header files
+#include "string_view.h"
+#include "mapped_csv.h"
+#include "arena.h"
+#include "cell_list.h"
+#include "reductions.h"
+#include "bitmap.h"
+#include "dataset.h"
+#include "maths.h"
+#include "porter_stemming.h"
+
+#include "dataset.impl.h"
+#include "dataset.column_data.h"
+#include "dataset.row_data.h"
+#include "dataset.parallel.h"
+#include "dataset.lazy.h"
+#include "dataset.snapshot.h"
+#include "dataset.describe.h"
+#include "row_group_reader.h"
+#include "record_index.h"
+
+#if defined(DATA_PROCESSING_USE_ZLIB)  ||  defined(DATA_PROCESSING_USE_ZSTD)
+#   include "compressed_reader.h"
+#endif
+
 namespace cdmh {
 
 namespace data_processing {
 
+// split a string of numbers separated by a delimiter, converting each
+// number to T
 template<typename T, typename U>
 inline
 std::vector<T> split_string(U const &string, char const delim)
@@ -32,8 +75,8 @@ std::vector<T> split_string(U const &string, char const delim)
     while (detail::ltrim(it,ite) != ite)
     {
         auto sp = std::find_if(it, ite, [delim](char ch) { return ch == delim; });
-        result.push_back(atol(std::string(it,sp).c_str()));
-        it = sp;
+        result.push_back(detail::to_number<T>(&*it, &*it + (sp - it)));
+        it = (sp == ite)? sp : sp + 1;
     }
     return result;
 }
@@ -41,24 +84,3 @@ std::vector<T> split_string(U const &string, char const delim)
 }   // namespace data_processing
 }   // namespace cdmh
 
-
-namespace {
-
-static cdmh::data_processing::type_mask_t const string_type  = 1;
-static cdmh::data_processing::type_mask_t const double_type  = 1 << 1;
-static cdmh::data_processing::type_mask_t const integer_type = 1 << 2;
-static cdmh::data_processing::type_mask_t const null_type    = 1 << 3;
-
-}   // anonymous namespace
-
-// project header files
-#include "string_view.h"
-#include "dataset.h"
-#include "mapped_csv.h"
-#include "maths.h"
-#include "porter_stemming.h"
-
-#include "dataset.impl.h"
-#include "dataset.column_data.h"
-#include "dataset.row_data.h"
-
@@ -5,6 +5,8 @@
 #pragma once
 
 #include <algorithm>
+#include <numeric>           // std::accumulate
+#include <unordered_set>
 
 namespace cdmh {
 namespace data_processing {
@@ -39,83 +41,232 @@ inline size_t const dataset::column_data::size() const
     return dd_.cells(column_).size();
 }
 
-// returns the number of non-null values in the column
+// returns the number of non-null values in the column, counting the
+// bits of the validity bitmap unless statistics have been collected
 inline size_t const dataset::column_data::count() const
 {
-    auto const &values = dd_.cells(column_);
-    return std::count_if(
-        values.begin(),
-        values.end(),
-        [](cell_value const &cell) {
-            return !cell.is_null();
-        });
+    auto const &values = dd_.values(column_);
+    if (values.statistics)
+        return values.statistics->count;
+    return detail::count_set_bits(values.valid.data(), values.valid.size());
 }
 
 // returns the number of null values in the column
 inline size_t const dataset::column_data::count_null() const
 {
-    auto const &values = dd_.cells(column_);
-    return std::count_if(
-        values.begin(),
-        values.end(),
-        [](cell_value const &cell) {
-            return cell.is_null();
-        });
+    return size() - count();
 }
 
+// returns the number of distinct non-null values in the column. the
+// distinct values of a string column are counted without case
 inline size_t const dataset::column_data::count_unique() const
 {
+    if (dd_.column_type(column_) == string_type)
+    {
+        if (!codes().empty())
+            return dictionary().size();
+
+        auto const &cells = dd_.cells(column_);
+        std::unordered_set<string_view, string_view_hash> unique;
+        for_each_row([&cells, &unique](size_t row) { unique.insert(cells[row].get<string_view>()); });
+        return unique.size();
+    }
+
     assert(dd_.column_type(column_) == integer_type  ||  dd_.column_type(column_) == double_type);
 
     if (dd_.column_type(column_) == double_type)
         return count_unique<double>();
-    return count_unique<std::uint32_t>();
+    return count_unique<std::int64_t>();
 }
 
 template<typename T>
 inline size_t const dataset::column_data::count_unique() const
 {
     std::unordered_map<T, unsigned> counts;
-    for (auto const &value : dd_.cells(column_))
-        if (!value.is_null())
-            counts[value.get<T>()]++;
+    for_each_value<T>([&counts](T value) { counts[value]++; });
     return counts.size();
 }
 
+// returns the dictionary code of each row of a string column with few
+// distinct values, or an empty vector if the column isn't encoded
+inline std::vector<std::uint32_t> const &dataset::column_data::codes() const
+{
+    dd_.encode_column(column_);
+    return dd_.column_values_[column_].codes;
+}
+
+// returns the distinct values of a dictionary encoded column, indexed
+// by code, or an empty vector if the column isn't encoded
+inline std::vector<string_view> const &dataset::column_data::dictionary() const
+{
+    dd_.encode_column(column_);
+    return dd_.column_values_[column_].dictionary;
+}
+
+// returns the rows with a value equal to 'value', compared without case.
+// a dictionary encoded column compares the code of each row
+inline std::vector<size_t> dataset::column_data::rows_matching(string_view const &value) const
+{
+    std::vector<size_t> rows;
+    auto const &codes = this->codes();
+    if (!codes.empty())
+    {
+        auto const &dictionary = this->dictionary();
+        auto const  it = std::find(dictionary.begin(), dictionary.end(), value);
+        if (it != dictionary.end())
+        {
+            auto const code = std::uint32_t(it - dictionary.begin());
+            for (size_t row=0; row<codes.size(); ++row)
+            {
+                if (codes[row] == code)
+                    rows.push_back(row);
+            }
+        }
+        return rows;
+    }
+
+    auto const &cells = dd_.cells(column_);
+    for_each_row(
+        [&cells, &rows, &value](size_t row) {
+            if (cells[row].get<string_view>() == value)
+                rows.push_back(row);
+        });
+    return rows;
+}
+
+// returns each distinct non-null value of the column with the number of
+// rows that have the value, in the order that the values first occur.
+// a dictionary encoded column counts the codes of the rows
+inline std::vector<std::pair<string_view, size_t>> dataset::column_data::value_counts() const
+{
+    std::vector<std::pair<string_view, size_t>> result;
+    auto const &codes = this->codes();
+    if (!codes.empty())
+    {
+        std::vector<size_t> counts(dictionary().size());
+        for (auto code : codes)
+        {
+            if (code != detail::null_code)
+                ++counts[code];
+        }
+        for (size_t loop=0; loop<counts.size(); ++loop)
+            result.push_back(std::make_pair(dictionary()[loop], counts[loop]));
+        return result;
+    }
+
+    auto const &cells = dd_.cells(column_);
+    std::unordered_map<string_view, size_t, string_view_hash> index;
+    for_each_row(
+        [&cells, &result, &index](size_t row) {
+            auto const value    = cells[row].get<string_view>();
+            auto const inserted = index.insert(std::make_pair(value, result.size()));
+            if (inserted.second)
+                result.push_back(std::make_pair(value, 0));
+            ++result[inserted.first->second].second;
+        });
+    return result;
+}
+
+// returns the statistics of a numeric column with values, if they have
+// been collected, otherwise nullptr
+inline dataset::column_statistics_t const *dataset::column_data::numeric_statistics() const
+{
+    auto const statistics = dd_.values(column_).statistics.get();
+    if (statistics == nullptr  ||  statistics->count == 0  ||  !(is_integer()  ||  is_double()))
+        return nullptr;
+    return statistics;
+}
+
+// call a function with the index of each non-null row of the column.
+// nulls are skipped a word of the validity bitmap at a time
+template<typename Fn>
+inline void dataset::column_data::for_each_row(Fn fn) const
+{
+    auto const &valid = dd_.values(column_).valid;
+    for (size_t word=0; word<valid.size(); ++word)
+    {
+        size_t const base = word * 64;
+        for (auto bits=valid[word]; bits != 0; bits &= bits - 1)
+            fn(base + detail::count_trailing_zeros(bits));
+    }
+}
+
+// call a function with each non-null value of the column as a T. the
+// native values of a numeric column are used if the column has them
+template<typename T, typename Fn>
+inline void dataset::column_data::for_each_value(Fn fn) const
+{
+    auto const &values = dd_.values(column_);
+    if (!values.integers.empty())
+        for_each_row([&values, &fn](size_t row) { fn(static_cast<T>(values.integers[row])); });
+    else if (!values.doubles.empty())
+        for_each_row([&values, &fn](size_t row) { fn(static_cast<T>(values.doubles[row])); });
+    else
+        for_each_row([&values, &fn](size_t row) { fn(values.cells[row].get<T>()); });
+}
+
 inline double const dataset::column_data::mean() const
 {
     assert(dd_.column_type(column_) == integer_type  ||  dd_.column_type(column_) == double_type);
 
     if (dd_.column_type(column_) == double_type)
         return sum<double>() / count();
-    return (double)sum<std::uint32_t>() / count();
+    return (double)sum<std::int64_t>() / count();
 }
 
+// the median, mode and standard deviation use the sorted values of the
+// column, which are materialised the first time that one is needed
 inline double const dataset::column_data::median() const
 {
     assert(dd_.column_type(column_) == integer_type  ||  dd_.column_type(column_) == double_type);
 
+    dd_.materialise_column(column_);
+    auto const &values = dd_.column_values_[column_];
     if (dd_.column_type(column_) == double_type)
-        return maths::median(dd_.extract_column<double>(column_, false));
-    return (double)maths::median(dd_.extract_column<std::uint32_t>(column_, false));
+        return maths::sorted_median(values.sorted_doubles);
+    return (double)maths::sorted_median(values.sorted_integers);
 }
 
 inline double const dataset::column_data::mode() const
 {
     assert(dd_.column_type(column_) == integer_type  ||  dd_.column_type(column_) == double_type);
 
+    dd_.materialise_column(column_);
+    auto const &values = dd_.column_values_[column_];
     if (dd_.column_type(column_) == double_type)
-        return maths::mode(dd_.extract_column<double>(column_, false));
-    return (double)maths::mode(dd_.extract_column<std::uint32_t>(column_, false));
+        return maths::sorted_mode(values.sorted_doubles);
+    return (double)maths::sorted_mode(values.sorted_integers);
 }
 
 inline double const dataset::column_data::standard_deviation() const
 {
     assert(dd_.column_type(column_) == integer_type  ||  dd_.column_type(column_) == double_type);
 
+    dd_.materialise_column(column_);
+    auto const &values = dd_.column_values_[column_];
     if (dd_.column_type(column_) == double_type)
-        return maths::standard_deviation(dd_.extract_column<double>(column_, false));
-    return maths::standard_deviation(dd_.extract_column<std::uint32_t>(column_, false));
+        return maths::standard_deviation(values.sorted_doubles);
+    return maths::standard_deviation(values.sorted_integers);
+}
+
+// returns the sum of the squares of the non-null values in the column
+inline double const dataset::column_data::sum_of_squares() const
+{
+    assert(dd_.column_type(column_) == integer_type  ||  dd_.column_type(column_) == double_type);
+
+    if (auto const statistics = numeric_statistics())
+        return statistics->sum_of_squares;
+
+    // nulls are stored as zero in the native values, so they add nothing
+    auto const &values = dd_.values(column_);
+    if (!values.integers.empty())
+        return detail::reduce_sum_of_squares(values.integers.data(), values.integers.size());
+    else if (!values.doubles.empty())
+        return detail::reduce_sum_of_squares(values.doubles.data(), values.doubles.size());
+
+    double sum = 0.0;
+    for_each_value<double>([&sum](double value) { sum += value * value; });
+    return sum;
 }
 
 template<typename T>
@@ -123,16 +274,26 @@ inline T dataset::column_data::max() const
 {
     assert(dd_.column_type(column_) == integer_type  ||  dd_.column_type(column_) == double_type);
 
-    T max = std::numeric_limits<T>::min();
-    for (auto const &value : dd_.cells(column_))
-    {
-        if (!value.is_null())
-        {
-            T val = value.get<T>();
-            if (val > max)
-                max = val;
-        }
-    }
+    auto const statistics = numeric_statistics();
+    if (statistics  &&  is_integer())
+        return static_cast<T>(statistics->integer_max);
+    else if (statistics)
+        return static_cast<T>(statistics->max);
+
+    auto const &values = dd_.values(column_);
+    std::int64_t integer_min, integer_max;
+    double       double_min,  double_max;
+    if (!values.integers.empty()  &&  detail::reduce_min_max(values.integers.data(), values.valid.data(), values.valid.size(), integer_min, integer_max))
+        return static_cast<T>(integer_max);
+    else if (!values.doubles.empty()  &&  detail::reduce_min_max(values.doubles.data(), values.valid.data(), values.valid.size(), double_min, double_max))
+        return static_cast<T>(double_max);
+
+    T max = std::numeric_limits<T>::lowest();
+    for_each_value<T>(
+        [&max](T value) {
+            if (value > max)
+                max = value;
+        });
     return max;
 }
 
@@ -141,23 +302,47 @@ inline T dataset::column_data::min() const
 {
     assert(dd_.column_type(column_) == integer_type  ||  dd_.column_type(column_) == double_type);
 
+    auto const statistics = numeric_statistics();
+    if (statistics  &&  is_integer())
+        return static_cast<T>(statistics->integer_min);
+    else if (statistics)
+        return static_cast<T>(statistics->min);
+
+    auto const &values = dd_.values(column_);
+    std::int64_t integer_min, integer_max;
+    double       double_min,  double_max;
+    if (!values.integers.empty()  &&  detail::reduce_min_max(values.integers.data(), values.valid.data(), values.valid.size(), integer_min, integer_max))
+        return static_cast<T>(integer_min);
+    else if (!values.doubles.empty()  &&  detail::reduce_min_max(values.doubles.data(), values.valid.data(), values.valid.size(), double_min, double_max))
+        return static_cast<T>(double_min);
+
     T min = std::numeric_limits<T>::max();
-    for (auto const &value : dd_.cells(column_))
-    {
-        if (!value.is_null())
-        {
-            T val = value.get<T>();
-            if (val < min)
-                min = val;
-        }
-    }
+    for_each_value<T>(
+        [&min](T value) {
+            if (value < min)
+                min = value;
+        });
     return min;
 }
 
 template<typename T>
 inline T const dataset::column_data::sum() const
 {
-    auto const &values = dd_.cells(column_);
+    auto const statistics = numeric_statistics();
+    if (statistics  &&  is_integer())
+        return static_cast<T>(statistics->integer_sum);
+    else if (statistics)
+        return static_cast<T>(statistics->sum);
+
+    // nulls are stored as zero in the native values, so the sum is a
+    // loop over the values without testing for nulls
+    auto const &native = dd_.values(column_);
+    if (!native.integers.empty())
+        return static_cast<T>(detail::reduce_sum(native.integers.data(), native.integers.size()));
+    else if (!native.doubles.empty())
+        return static_cast<T>(detail::reduce_sum(native.doubles.data(), native.doubles.size()));
+
+    auto const &values = native.cells;
     return std::accumulate(
         values.begin(),
         values.end(),
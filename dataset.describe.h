@@ -0,0 +1,146 @@
+// Copyright (c) 2013 Craig Henderson
+// Part of the Data Processing Library
+// https://github.com/cdmh/dataproc
+
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace cdmh {
+namespace data_processing {
+namespace detail {
+
+// the count, mean and sum of squared differences from the mean of a set
+// of values, which are accumulated without the loss of precision of
+// summing the squares of the values. values are added a block at a time;
+// the mean and squared differences of a block are found from the block,
+// and merged with those of the values before it as in Welford's method
+class moments
+{
+  public:
+    moments() : count_(0), mean_(0.0), squares_(0.0)
+    { }
+
+    size_t const count()    const { return count_; }
+    double const mean()     const { return mean_;  }
+    double const variance() const { return squares_ / count_; }
+
+    void add(double const *values, size_t count)
+    {
+        if (count == 0)
+            return;
+
+        double sum = 0.0;
+        for (size_t loop=0; loop<count; ++loop)
+            sum += values[loop];
+        double const mean = sum / count;
+
+        double squares = 0.0;
+        for (size_t loop=0; loop<count; ++loop)
+            squares += (values[loop] - mean) * (values[loop] - mean);
+
+        double const delta = mean - mean_;
+        size_t const total = count_ + count;
+        mean_    += delta * count / total;
+        squares_ += squares + delta * delta * (double(count_) * count / total);
+        count_    = total;
+    }
+
+  private:
+    size_t count_;
+    double mean_;
+    double squares_;
+};
+
+}   // namespace detail
+
+// returns the summary statistics of each numeric column. each column is
+// read once, and the columns are read concurrently
+inline std::vector<column_summary> dataset::describe(unsigned thread_count) const
+{
+    std::vector<size_t> numeric;
+    for (size_t column=0; column<columns(); ++column)
+    {
+        if (column_type(column) == integer_type  ||  column_type(column) == double_type)
+            numeric.push_back(column);
+    }
+
+    if (thread_count == 0)
+        thread_count = std::max(1U, std::thread::hardware_concurrency());
+    thread_count = (unsigned)std::min<size_t>(thread_count, numeric.size());
+
+    // each thread takes the next column to be read until all are read
+    std::vector<column_summary> result(numeric.size());
+    std::atomic<size_t> next_column(0);
+    auto describe_columns = [this, &numeric, &result, &next_column]() {
+        for (size_t index; (index = next_column++) < numeric.size(); )
+            result[index] = describe_column(numeric[index]);
+    };
+
+    if (thread_count <= 1)
+        describe_columns();
+    else
+    {
+        std::vector<std::thread> threads;
+        for (unsigned loop=0; loop<thread_count; ++loop)
+            threads.emplace_back(describe_columns);
+        for (auto &thread : threads)
+            thread.join();
+    }
+    return result;
+}
+
+// returns the summary statistics of a numeric column, reading the native
+// values a word of the null bitmap at a time. a column without native
+// values for each row parses the value of each cell
+inline column_summary const dataset::describe_column(size_t column) const
+{
+    auto const &values = this->values(column);
+    double const nan = std::numeric_limits<double>::quiet_NaN();
+    bool const integers = (values.integers.size() == values.cells.size());
+    bool const doubles  = (values.doubles.size() == values.cells.size());
+
+    double block[64];
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    detail::moments moments;
+    for (size_t word=0; word<values.valid.size(); ++word)
+    {
+        size_t const base = word * 64;
+        size_t count = 0;
+        for (auto bits=values.valid[word]; bits != 0; bits &= bits - 1)
+        {
+            size_t const row = base + detail::count_trailing_zeros(bits);
+            if (integers)
+                block[count++] = double(values.integers[row]);
+            else if (doubles)
+                block[count++] = values.doubles[row];
+            else
+                block[count++] = values.cells[row].get<double>();
+        }
+
+        for (size_t loop=0; loop<count; ++loop)
+        {
+            min = std::min(min, block[loop]);
+            max = std::max(max, block[loop]);
+        }
+        moments.add(block, count);
+    }
+
+    column_summary summary;
+    summary.name       = column_title(column);
+    summary.type       = column_type(column);
+    summary.count      = moments.count();
+    summary.count_null = values.cells.size() - moments.count();
+    summary.mean       = (moments.count() == 0)? nan : moments.mean();
+    summary.standard_deviation = (moments.count() == 0)? nan : sqrt(moments.variance());
+    summary.min        = (moments.count() == 0)? nan : min;
+    summary.max        = (moments.count() == 0)? nan : max;
+    return summary;
+}
+
+}   // namespace data_processing
+}   // namespace cdmh
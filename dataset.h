@@ -6,6 +6,60 @@ namespace cdmh {
 
 namespace data_processing {
 
+template<typename Dialect>
+class basic_record_index;
+
+namespace detail {
+
+// the dictionary code of a null value, and the most distinct values
+// that a column can have to be dictionary encoded
+static std::uint32_t const null_code           = 0xffffffff;
+static size_t        const max_dictionary_size = 1 << 16;
+
+}   // namespace detail
+
+// the name and type of a column, to attach with a known schema
+struct column_schema
+{
+    column_schema(char const *name, type_mask_t type, bool nullable=true)
+      : name(name), type(type), nullable(nullable)
+    { }
+
+    std::string name;
+    type_mask_t type;
+    bool        nullable;
+};
+
+// the summary statistics of a numeric column, returned by describe().
+// the mean, standard deviation, min and max are NaN if the column has
+// no values. the standard deviation is of the population, as returned
+// by column_data::standard_deviation
+struct column_summary
+{
+    std::string name;
+    type_mask_t type;
+    size_t      count;
+    size_t      count_null;
+    double      mean;
+    double      standard_deviation;
+    double      min;
+    double      max;
+};
+
+// the columns to keep when attaching, either by name or by index.
+// the columns of the dataset are in the order given
+class column_projection
+{
+  public:
+    column_projection(std::vector<std::string> const &names)  : names_(names)     { }
+    column_projection(std::vector<size_t> const &indices)     : indices_(indices) { }
+
+  private:
+    friend class dataset;
+    std::vector<std::string> names_;
+    std::vector<size_t>      indices_;
+};
+
 class dataset
 {
   public:
@@ -20,22 +74,70 @@ class dataset
         { }
     };
 
-    template<typename It>
+    class schema_mismatch : public std::runtime_error
+    {
+      public:
+        schema_mismatch() : std::runtime_error("Header does not match the schema")
+        { }
+    };
+
+    class header_mismatch : public std::runtime_error
+    {
+      public:
+        header_mismatch() : std::runtime_error("Headers of the files do not match")
+        { }
+    };
+
+    class invalid_snapshot : public std::runtime_error
+    {
+      public:
+        invalid_snapshot() : std::runtime_error("Invalid snapshot file")
+        { }
+    };
+
+    // the row and column of a cell that is not valid for its schema type
+    typedef std::pair<size_t, size_t> cell_position_t;
+
+    // the cells of a column, stored as 32 bit offsets into the attached
+    // data. the elements are cell_values, which are returned by value
+    typedef detail::cell_list<cell_value> cell_list_t;
+
+    dataset();
+
+    template<typename Dialect=csv_dialect, typename It>
     bool const attach(It begin, It end, std::uint64_t max_records=0);
+    template<typename Dialect=csv_dialect>
     bool const attach(char const *data, std::uint64_t max_records=0);
+    template<typename Dialect=csv_dialect>
+    bool const attach_parallel(char const *begin, char const *end, unsigned thread_count=0);
+    template<typename Dialect=csv_dialect, typename It>
+    bool const attach(It begin, It end, std::vector<column_schema> const &schema, std::uint64_t max_records=0);
+    template<typename Dialect=csv_dialect, typename It>
+    bool const attach(It begin, It end, column_projection const &projection, std::uint64_t max_records=0);
+    template<typename Dialect=csv_dialect>
+    bool const attach_lazy(char const *begin, char const *end);
+    template<typename Dialect>
+    bool const attach_rows(basic_record_index<Dialect> const &index, size_t first_row, size_t last_row);
+    template<typename Dialect=csv_dialect>
+    bool const attach_files(std::vector<std::string> const &filenames, unsigned thread_count=0);
+    bool const open_snapshot(std::string const &filename);
+    void save_snapshot(std::string const &filename) const;
 
     row_data                            operator[](size_t n)               const;
     template<typename U> U              at(size_t row, size_t column)      const;
-    cell_value              const      &cell(size_t row, size_t column)    const;
-    std::vector<cell_value> const      &cells(size_t column)               const;
+    cell_value              const       cell(size_t row, size_t column)    const;
+    cell_list_t             const      &cells(size_t column)               const;
     column_data                         column(int n)                      const;
     column_data                         column(size_t column)              const;
     column_data                         column(char const *name)           const;
+    std::vector<column_summary>         describe(unsigned thread_count=0)  const;
     size_t                  const       columns()                          const;
     type_mask_t             const       column_type(size_t column)         const;
     std::string                         column_title(size_t column)        const;
+    void                                collect_statistics(bool collect=true);
     void                                erase_column(size_t column);
     template<typename T> std::vector<T> extract_column(size_t column, bool include_nulls=false) const;
+    std::vector<cell_position_t> const &invalid_cells()                const;
     bool                    const       is_attached()                      const;
     size_t                  const       lookup_column(char const *name)    const;
     row_data                            row(size_t row)                    const;
@@ -43,24 +145,240 @@ class dataset
     void                                write_column_info(std::ostream &o) const;
 
   private:
+    void append(dataset &&other);
+    void create_columns(dataset const &other);
+    bool const same_columns(dataset const &other) const;
     void create_column(unsigned index, string_view const &name, type_mask_t /*type*/);
+    void erase_rows();
     void store_field(unsigned index, string_view const &value, type_mask_t type);
+    void store_typed_field(unsigned index, string_view const &value, type_mask_t type, bool nullable);
+    void widen_column_type(size_t index, type_mask_t type);
+    void store_native_value(unsigned index, string_view const &value, type_mask_t type);
+    void parse_native_values(size_t column);
+    void discard_native_values(size_t column);
+    void compute_statistics(size_t column);
+    column_summary const describe_column(size_t column)        const;
+    void reserve_rows(size_t rows);
+    template<typename Dialect> void reserve_records(char const *begin, char const *end, std::uint64_t max_records);
+    template<typename Dialect, typename It> void reserve_records(It begin, It end, std::uint64_t max_records);
+    void record_escaped(unsigned index);
+    void unescape_column(size_t column)                        const;
+    string_view const unescape(string_view const &value)       const;
+    void encode_column(size_t column)                          const;
+    void materialise_column(size_t column)                     const;
+
+    char        const *record_start(size_t row)                const;
+    void               decode_column(size_t column)            const;
+    cell_value  const  decode_cell(size_t row, size_t column)  const;
+    template<typename Dialect> static void decode_lazy_column(dataset &ds, size_t column);
+    template<typename Dialect> static void decode_lazy_row(dataset &ds, size_t row, std::vector<cell_value> &cells);
 
-    template<typename It, typename Fn>
-    bool const process_record(It &begin, It end, Fn fn);
+    template<typename Dialect, typename It>
+    void attach_header(detail::basic_structural_scanner<Dialect> &scanner, It &begin, It end);
+
+    template<typename Dialect, typename It>
+    It attach_records(detail::basic_structural_scanner<Dialect> &scanner, It &begin, It end, std::uint64_t max_records);
+
+    template<typename Dialect, bool InferTypes=true, typename It, typename Fn>
+    bool const process_record(detail::basic_structural_scanner<Dialect> &scanner, It &begin, It end, Fn const &fn);
+
+    template<typename Dialect, typename It, typename Fn>
+    bool const process_projected_record(detail::basic_structural_scanner<Dialect> &scanner, It &begin, It end, std::vector<int> const &targets, Fn const &fn);
 
   private:
     typedef std::pair<string_view, type_mask_t> column_info_t;
     typedef std::vector<cell_value>             string_list_t;
-    std::vector<column_info_t> column_info_;
-    std::vector<string_list_t> column_values_;
+
+    // summary statistics of a column, which are collected as the column
+    // is attached if collect_statistics() is called before attaching. the
+    // count is of the non-null values of the column, and the others are of
+    // the values of a numeric column, as integers or doubles by the type
+    // of the column. doubles are added as they are stored, rather than
+    // into the partial sums of the kernels, so their sums can differ from
+    // those of a column without statistics in the last bits
+    struct column_statistics_t
+    {
+        column_statistics_t()
+          : count(0),
+            integer_min(std::numeric_limits<std::int64_t>::max()),
+            integer_max(std::numeric_limits<std::int64_t>::min()),
+            integer_sum(0),
+            min(std::numeric_limits<double>::max()),
+            max(std::numeric_limits<double>::lowest()),
+            sum(0.0),
+            sum_of_squares(0.0)
+        { }
+
+        void add(std::int64_t value)
+        {
+            integer_min     = std::min(integer_min, value);
+            integer_max     = std::max(integer_max, value);
+            integer_sum     = wrapping_add(integer_sum, value);
+            sum_of_squares += double(value) * double(value);
+        }
+
+        void add(double value)
+        {
+            min             = std::min(min, value);
+            max             = std::max(max, value);
+            sum            += value;
+            sum_of_squares += value * value;
+        }
+
+        void merge(column_statistics_t const &other)
+        {
+            count          += other.count;
+            integer_min     = std::min(integer_min, other.integer_min);
+            integer_max     = std::max(integer_max, other.integer_max);
+            integer_sum     = wrapping_add(integer_sum, other.integer_sum);
+            min             = std::min(min, other.min);
+            max             = std::max(max, other.max);
+            sum            += other.sum;
+            sum_of_squares += other.sum_of_squares;
+        }
+
+        // integers are added as unsigned values, which wrap on overflow
+        // as the sum kernels do
+        static std::int64_t const wrapping_add(std::int64_t first, std::int64_t second)
+        {
+            return std::int64_t(std::uint64_t(first) + std::uint64_t(second));
+        }
+
+        size_t       count;
+        std::int64_t integer_min;
+        std::int64_t integer_max;
+        std::int64_t integer_sum;
+        double       min;
+        double       max;
+        double       sum;
+        double       sum_of_squares;
+    };
+
+    // the cells of a column, and the native values of a numeric column,
+    // which are parsed as the column is attached. null values are stored
+    // as zero in the native values. cells of quoted values with
+    // escaped quotes refer to the raw value until the column is first
+    // accessed, when they are unescaped into the arena. a string column
+    // with few distinct values is dictionary encoded when it is first
+    // grouped or filtered
+    struct column_values_t
+    {
+        column_values_t() : reserved(0), encode_once(new std::once_flag), materialise_once(new std::once_flag)
+        { }
+
+        cell_list_t                     cells;
+        std::vector<std::int64_t>       integers;
+        std::vector<double>             doubles;
+        std::vector<std::uint64_t>      valid;          // a bit for each row that isn't null
+        size_t                          reserved;       // the expected number of rows
+        std::vector<size_t>             escaped;        // rows to unescape
+        std::unique_ptr<std::once_flag> unescape_once;
+        std::vector<std::uint32_t>      codes;          // the dictionary code of each row
+        std::vector<string_view>        dictionary;     // the distinct values of the column
+        std::unique_ptr<std::once_flag> encode_once;
+        std::vector<std::int64_t>       sorted_integers;    // the non-null values of a numeric
+        std::vector<double>             sorted_doubles;     // column, in ascending order
+        std::unique_ptr<std::once_flag> materialise_once;
+        std::unique_ptr<column_statistics_t> statistics;    // null unless statistics are collected
+    };
+
+    column_values_t const &values(size_t column) const;
+
+    std::vector<column_info_t>      column_info_;
+    std::vector<column_values_t>    column_values_;
+    std::vector<cell_position_t>    invalid_cells_;
+    char                            quote_;
+    bool                            collect_statistics_;
+    std::unique_ptr<detail::arena>  arena_;
+
+    // the index of a lazily attached dataset. only the offset of each
+    // record is stored by attach_lazy, and the fields are decoded when a
+    // column or row is first accessed. the offsets are 32 bit unless the
+    // data is 4GB or larger. only the last row that is decoded by cell
+    // access is kept, so reading the rows in turn doesn't keep every cell
+    struct lazy_index_t
+    {
+        char const                 *begin;
+        char const                 *end;
+        std::vector<std::uint32_t>  offsets32;
+        std::vector<std::uint64_t>  offsets64;
+        std::vector<size_t>         fields;         // the field of each column
+        std::vector<bool>           decoded;        // columns that have been decoded
+        size_t                      row;            // the row decoded by cell access
+        string_list_t               row_cells;      // the cells of the decoded row
+        std::vector<unsigned>       row_escaped;    // the escaped fields of the decoded row
+        std::vector<char>           row_buffer;     // the unescaped values of the decoded row
+        std::mutex                  mutex;
+        void (*decode_column)(dataset &ds, size_t column);
+        void (*decode_row)(dataset &ds, size_t row, string_list_t &cells);
+    };
+    std::unique_ptr<lazy_index_t> lazy_;
+
+    // files mapped by attach_files, which the cells refer to
+    std::vector<std::unique_ptr<memory_mapped_file<char>>> files_;
 
     template<typename E, typename T>
     friend
     std::basic_ostream<E,T> &operator<<(std::basic_ostream<E,T> &o, dataset const &dd);
 
+    template<typename Dialect>
+    friend class basic_row_group_reader;
+
+    template<typename Dialect>
+    friend class basic_compressed_reader;
+};
+
+// reads a buffer of CSV records as a sequence of datasets of at most
+// rows_per_group rows each, so that a large file can be processed with
+// bounded memory. the storage of each group is reused for the next
+template<typename Dialect>
+class basic_row_group_reader
+{
+  public:
+    basic_row_group_reader(char const *begin, char const *end, size_t rows_per_group);
+    basic_row_group_reader(basic_row_group_reader const &)            = delete;
+    basic_row_group_reader &operator=(basic_row_group_reader const &) = delete;
+
+    std::uint64_t   const  first_row() const { return first_row_; }
+    dataset         const &group()     const { return group_;     }
+    bool            const  next();
+
+  private:
+    dataset                                    group_;
+    detail::basic_structural_scanner<Dialect>  scanner_;
+    char const                                *it_;
+    char const                         * const end_;
+    size_t                               const rows_per_group_;
+    std::uint64_t                              first_row_;
+};
+
+typedef basic_row_group_reader<csv_dialect> row_group_reader;
+
+// an index of the start of each record in a buffer of CSV records. the
+// index is built concurrently, with the buffer split at record boundaries
+// by the parity of the quotes, so that a range of rows can be attached
+// without reading the rows before it
+template<typename Dialect>
+class basic_record_index
+{
+  public:
+    basic_record_index(char const *begin, char const *end, unsigned thread_count=0);
+    basic_record_index(basic_record_index const &)            = delete;
+    basic_record_index &operator=(basic_record_index const &) = delete;
+
+    char    const *end()            const { return end_;            }
+    char    const *header()         const { return header_;         }
+    char    const *record(size_t n) const;
+    size_t  const  size()           const { return records_.size(); }
+
+  private:
+    char const                 *header_;
+    char const         * const end_;
+    std::vector<char const *>   records_;
 };
 
+typedef basic_record_index<csv_dialect> record_index;
+
 class dataset::row_data
 {
   public:
@@ -96,9 +414,14 @@ class dataset::row_data::cell_reference
 
   protected:
     cell_reference(dataset const &ds,size_t row,size_t column);
+    char const quote() const;
 
     friend row_data;
 
+    template<typename E, typename T>
+    friend
+    std::basic_ostream<E,T> &operator<<(std::basic_ostream<E,T> &o, cell_reference const &value);
+
     private:
     dataset const &dd_;
     size_t  const  row_;
@@ -136,6 +459,8 @@ class dataset::column_data
                             size_t const   count_null()         const;
                             size_t const   count_unique()       const;
     template<typename T>    size_t const   count_unique()       const;
+                            std::vector<std::uint32_t> const &codes()      const;
+                            std::vector<string_view>   const &dictionary() const;
     template<typename T>    std::vector<T> extract()            const;
                             bool   const   is_double()          const { return dd_.column_type(column_) == double_type;  }
                             bool   const   is_integer()         const { return dd_.column_type(column_) == integer_type; }
@@ -145,9 +470,17 @@ class dataset::column_data
                             double const   mean()               const;
                             double const   median()             const;
                             double const   mode()               const;
+                            std::vector<size_t> rows_matching(string_view const &value) const;
                             size_t const   size()               const;
     template<typename T>    T const        sum()                const;
                             double const   standard_deviation() const;
+                            double const   sum_of_squares()     const;
+                            std::vector<std::pair<string_view, size_t>> value_counts() const;
+
+  private:
+    column_statistics_t const *numeric_statistics() const;
+    template<typename Fn>             void for_each_row(Fn fn)   const;
+    template<typename T, typename Fn> void for_each_value(Fn fn) const;
 
   private:
     dataset const &dd_;
@@ -8,8 +8,21 @@ namespace cdmh {
 
 namespace data_processing {
 
-inline std::vector<dataset::cell_value> const &dataset::cells(size_t column) const
+inline dataset::dataset() : quote_('"'), collect_statistics_(false)
 {
+}
+
+inline dataset::cell_list_t const &dataset::cells(size_t column) const
+{
+    return values(column).cells;
+}
+
+// returns the values of a column, decoding the column if it is lazily
+// attached and unescaping quoted values
+inline dataset::column_values_t const &dataset::values(size_t column) const
+{
+    decode_column(column);
+    unescape_column(column);
     return column_values_[column];
 }
 
@@ -21,9 +34,12 @@ T dataset::at(size_t row, size_t column) const
 }
 
 inline
-dataset::cell_value const &dataset::cell(size_t row, size_t column) const
+dataset::cell_value const dataset::cell(size_t row, size_t column) const
 {
-    return column_values_[column][row];
+    if (lazy_)
+        return decode_cell(row, column);
+    unescape_column(column);
+    return column_values_[column].cells[row];
 }
 
 inline size_t const dataset::columns() const
@@ -31,9 +47,67 @@ inline size_t const dataset::columns() const
     return column_values_.size();
 }
 
+// collect summary statistics of each column as the dataset is attached,
+// so that count(), count_null(), min(), max(), sum() and sum_of_squares()
+// of a column don't read the column. must be called before attaching
+inline void dataset::collect_statistics(bool collect)
+{
+    assert(!is_attached());
+    collect_statistics_ = collect;
+}
+
+// remove a column. the invalid cells of the column are removed, and the
+// columns after it move down, so the columns of the other invalid cells
+// are adjusted
 inline void dataset::erase_column(size_t column)
 {
+    column_info_.erase(column_info_.begin() + column);
     column_values_.erase(column_values_.begin() + column);
+    invalid_cells_.erase(
+        std::remove_if(
+            invalid_cells_.begin(),
+            invalid_cells_.end(),
+            [column](cell_position_t const &position) { return position.second == column; }),
+        invalid_cells_.end());
+    for (auto &position : invalid_cells_)
+    {
+        if (position.second > column)
+            --position.second;
+    }
+    if (lazy_)
+    {
+        lazy_->fields.erase(lazy_->fields.begin() + column);
+        lazy_->decoded.erase(lazy_->decoded.begin() + column);
+    }
+}
+
+// remove all rows, leaving the columns and their names. the storage
+// is kept for reuse
+inline void dataset::erase_rows()
+{
+    for (auto &column : column_info_)
+        column.second = 0;
+    for (auto &values : column_values_)
+    {
+        values.cells.clear();
+        values.integers.clear();
+        values.doubles.clear();
+        values.valid.clear();
+        values.reserved = 0;
+        values.escaped.clear();
+        values.unescape_once.reset();
+        values.codes.clear();
+        values.dictionary.clear();
+        values.encode_once.reset(new std::once_flag);
+        values.sorted_integers.clear();
+        values.sorted_doubles.clear();
+        values.materialise_once.reset(new std::once_flag);
+        if (values.statistics)
+            values.statistics.reset(new column_statistics_t);
+    }
+    invalid_cells_.clear();
+    if (arena_)
+        arena_->clear();
 }
 
 inline bool const dataset::row_data::cell_reference::is_null() const
@@ -55,12 +129,14 @@ inline size_t const dataset::rows() const
 {
     if (columns() == 0)
         return 0;
+    else if (lazy_)
+        return lazy_->offsets32.size() + lazy_->offsets64.size();
 
 #ifndef NDEBUG
     for (size_t loop=1; loop<column_values_.size(); ++loop)
-        assert(column_values_[loop].size() == column_values_[0].size());
+        assert(column_values_[loop].cells.size() == column_values_[0].cells.size());
 #endif
-    return column_values_[0].size();
+    return column_values_[0].cells.size();
 }
 
 inline std::string dataset::column_title(size_t column) const
@@ -73,20 +149,63 @@ inline std::string dataset::column_title(size_t column) const
 
 inline type_mask_t const dataset::column_type(size_t column) const
 {
+    decode_column(column);
     return column_info_[column].second;
 }
 
+namespace detail {
+
+// read the native values of a parsed column as an arithmetic type
+template<typename T, typename Values>
+inline bool const extract_native(Values const &values, bool include_nulls, std::vector<T> &result, std::true_type)
+{
+    if (values.integers.empty()  &&  values.doubles.empty())
+        return false;
+
+    for (size_t loop=0; loop<values.cells.size(); ++loop)
+    {
+        if (include_nulls  ||  test_bit(values.valid, loop))
+        {
+            if (values.integers.empty())
+                result.push_back(static_cast<T>(values.doubles[loop]));
+            else
+                result.push_back(static_cast<T>(values.integers[loop]));
+        }
+    }
+    return true;
+}
+
+// other types, such as strings, are read from the cells
+template<typename T, typename Values>
+inline bool const extract_native(Values const &, bool, std::vector<T> &, std::false_type)
+{
+    return false;
+}
+
+}   // namespace detail
+
 template<typename T>
 inline std::vector<T> dataset::extract_column(size_t column, bool include_nulls) const
 {
+    auto const &values = this->values(column);
     std::vector<T> result;
-    result.reserve(column_values_[column].size());
-    for (auto &value : column_values_[column])
-        if (include_nulls  ||  !value.is_null())
-            result.push_back(value.get<T>());
+    result.reserve(values.cells.size());
+
+    // use native values if the column has been parsed
+    if (detail::extract_native(values, include_nulls, result, std::integral_constant<bool, std::is_arithmetic<T>::value>()))
+        return result;
+
+    for (size_t loop=0; loop<values.cells.size(); ++loop)
+        if (include_nulls  ||  detail::test_bit(values.valid, loop))
+            result.push_back(values.cells[loop].get<T>());
     return result;
 }
 
+inline std::vector<dataset::cell_position_t> const &dataset::invalid_cells() const
+{
+    return invalid_cells_;
+}
+
 inline size_t const dataset::lookup_column(char const *name) const
 {
     size_t index = 0;
@@ -112,14 +231,21 @@ template<>
 inline
 double dataset::cell_value::get() const
 {
-    return strtod(string_.begin(), nullptr);
+    return detail::to_double(string_.begin(), string_.end());
 }
 
 template<>
 inline
 std::uint32_t dataset::cell_value::get() const
 {
-    return strtol(string_.begin(), nullptr, 10);
+    return std::uint32_t(detail::to_integer(string_.begin(), string_.end()));
+}
+
+template<>
+inline
+std::int64_t dataset::cell_value::get() const
+{
+    return detail::to_integer(string_.begin(), string_.end());
 }
 
 template<>
@@ -144,56 +270,185 @@ std::string dataset::cell_value::get() const
 
 
 
-namespace { // anonymous namespace
-
-template<typename It>
+template<typename Dialect, typename It>
 inline
-It find_eol(It it, It ite)
+bool const dataset::attach(It begin, It end, std::uint64_t max_records)
 {
-    while (it != ite)
+    detail::basic_structural_scanner<Dialect> scanner(end);
+    attach_header(scanner, begin, end);
+    reserve_records<Dialect>(begin, end, max_records);
+    attach_records(scanner, begin, end, max_records);
+    return true;
+}
+
+// reserve storage for the records of a buffer from an estimate of the
+// number of records, so that the columns aren't reallocated as they grow
+template<typename Dialect>
+inline void dataset::reserve_records(char const *begin, char const *end, std::uint64_t max_records)
+{
+    std::uint64_t rows = detail::estimate_records(begin, end);
+    if (max_records != 0)
+        rows = std::min(rows, max_records);
+    reserve_rows((size_t)rows);
+}
+
+// the records of other iterators are not sampled
+template<typename Dialect, typename It>
+inline void dataset::reserve_records(It /*begin*/, It /*end*/, std::uint64_t /*max_records*/)
+{
+}
+
+inline void dataset::reserve_rows(size_t rows)
+{
+    for (size_t loop=0; loop<columns(); ++loop)
     {
-        detail::read_field(it, ite);
-        if (it == ite  ||  *it == '\r'  ||  *it == '\n')
-            return it;
-        assert(*it == ',');
-        ++it;
+        auto &values = column_values_[loop];
+        values.reserved = values.cells.size() + rows;
+        values.cells.reserve(values.reserved);
+        values.valid.reserve((values.reserved + 63) / 64);
+        if (column_info_[loop].second == integer_type)
+            values.integers.reserve(values.reserved);
+        else if (column_info_[loop].second == double_type)
+            values.doubles.reserve(values.reserved);
     }
-    return it;
 }
 
-}   // anonymous namespace
+// the first record is the header, which names the columns
+template<typename Dialect, typename It>
+inline
+void dataset::attach_header(detail::basic_structural_scanner<Dialect> &scanner, It &begin, It end)
+{
+    quote_ = char(Dialect::quote);
+    if (detail::skip_blank<Dialect>(begin, end) != end)
+    {
+        process_record(
+            scanner, begin, end,
+            [this](unsigned index, string_view const &name, type_mask_t type) {
+                create_column(index, name, type);
+            });
+    }
+}
 
-template<typename It>
+template<typename Dialect, typename It>
 inline
-bool const dataset::attach(It begin, It end, std::uint64_t max_records)
+It dataset::attach_records(detail::basic_structural_scanner<Dialect> &scanner, It &begin, It end, std::uint64_t max_records)
 {
-    typedef 
-    std::function<void (unsigned, string_view &, type_mask_t)>
-    store_fn_t;
+    // the sink is a distinct type for the header and data records, so
+    // each call to process_record is inlined without indirection
+    auto store = [this](unsigned index, string_view const &value, type_mask_t type) {
+        store_field(index, value, type);
+    };
+
+    // each record is read in a single pass; process_record stops at the
+    // end of line, and blank lines between records are skipped here
+    while (detail::skip_blank<Dialect>(begin, end) != end  &&  (max_records == 0  ||  rows() < max_records))
+        process_record(scanner, begin, end, store);
+
+    return begin;
+}
 
-    using std::placeholders::_1;
-    using std::placeholders::_2;
-    using std::placeholders::_3;
-    store_fn_t store         = std::bind(&dataset::create_column, this, _1, _2, _3);
-    store_fn_t store_fields  = std::bind(&dataset::store_field, this, _1, _2, _3);
+template<typename Dialect>
+inline bool const dataset::attach(char const *data, std::uint64_t max_records)
+{
+    return attach<Dialect>(data, data+strlen(data), max_records);
+}
 
-    while (begin != end  &&  (max_records == 0  ||  rows() < max_records))
+// attach with a known schema. the header record must name the columns
+// of the schema, in order. the types are not inferred from the values;
+// numeric values are parsed as they are read, and values that are not
+// valid for the column are stored as nulls and listed by invalid_cells()
+template<typename Dialect, typename It>
+inline
+bool const dataset::attach(It begin, It end, std::vector<column_schema> const &schema, std::uint64_t max_records)
+{
+    detail::basic_structural_scanner<Dialect> scanner(end);
+    try
     {
-        auto eol = find_eol(detail::ltrim(begin, end), end);
-        if (begin != end)
+        attach_header(scanner, begin, end);
+        if (columns() != schema.size())
+            throw schema_mismatch();
+
+        for (size_t loop=0; loop<schema.size(); ++loop)
         {
-            process_record(begin, eol, store);
-            assert(begin == eol);
-            store = store_fields;
+            if (!(column_info_[loop].first == schema[loop].name.c_str()))
+                throw schema_mismatch();
+            column_info_[loop].second = schema[loop].type;
         }
+        reserve_records<Dialect>(begin, end, max_records);
+
+        auto store = [this, &schema](unsigned index, string_view const &value, type_mask_t type) {
+            if (index >= schema.size())
+                throw schema_mismatch();
+            store_typed_field(index, value, type, schema[index].nullable);
+        };
+
+        while (detail::skip_blank<Dialect>(begin, end) != end  &&  (max_records == 0  ||  rows() < max_records))
+            process_record<Dialect, false>(scanner, begin, end, store);
+    }
+    catch (schema_mismatch const &)
+    {
+        // a record with too many fields has stored some of its fields, so
+        // the columns are removed rather than left with different lengths,
+        // and the dataset can be attached again
+        column_info_.clear();
+        column_values_.clear();
+        invalid_cells_.clear();
+        if (arena_)
+            arena_->clear();
+        throw;
     }
 
     return true;
 }
 
-inline bool const dataset::attach(char const *data, std::uint64_t max_records)
+// attach only the columns of a projection. the fields of other columns
+// are skipped without being read, so no cells are stored for them
+template<typename Dialect, typename It>
+inline
+bool const dataset::attach(It begin, It end, column_projection const &projection, std::uint64_t max_records)
 {
-    return attach(data, data+strlen(data), max_records);
+    detail::basic_structural_scanner<Dialect> scanner(end);
+    std::vector<string_view> names;
+    if (detail::skip_blank<Dialect>(begin, end) != end)
+    {
+        process_record(
+            scanner, begin, end,
+            [&names](unsigned /*index*/, string_view const &name, type_mask_t /*type*/) {
+                names.push_back(name);
+            });
+    }
+
+    // map each field of a record to its column in the dataset, or -1
+    std::vector<size_t> sources(projection.indices_);
+    for (auto const &name : projection.names_)
+    {
+        auto it = std::find_if(names.begin(), names.end(), [&name](string_view const &n) { return n == name.c_str(); });
+        if (it == names.end())
+            throw invalid_column_name();
+        sources.push_back(it - names.begin());
+    }
+
+    std::vector<int> targets(names.size(), -1);
+    for (auto source : sources)
+    {
+        if (source >= names.size())
+            throw std::out_of_range("Invalid column index");
+        if (targets[source] == -1)
+        {
+            targets[source] = (int)columns();
+            create_column((unsigned)columns(), names[source], 0);
+        }
+    }
+    reserve_records<Dialect>(begin, end, max_records);
+
+    auto store = [this](unsigned index, string_view const &value, type_mask_t type) {
+        store_field(index, value, type);
+    };
+
+    while (detail::skip_blank<Dialect>(begin, end) != end  &&  (max_records == 0  ||  rows() < max_records))
+        process_projected_record(scanner, begin, end, targets, store);
+
+    return true;
 }
 
 inline bool const dataset::is_attached() const
@@ -209,24 +464,55 @@ inline void dataset::create_column(unsigned index, string_view const &name, type
     assert(index == column_info_.size());
 #endif
     column_info_.push_back(column_info_t(name, 0));
-    column_values_.push_back(string_list_t());
+    column_values_.push_back(column_values_t());
+    if (collect_statistics_)
+        column_values_.back().statistics.reset(new column_statistics_t);
 }
 
-template<typename It, typename Fn>
+template<typename Dialect, bool InferTypes, typename It, typename Fn>
 inline
-bool const dataset::process_record(It &begin, It end, Fn fn)
+bool const dataset::process_record(detail::basic_structural_scanner<Dialect> &scanner, It &begin, It end, Fn const &fn)
 {
-    for (unsigned index=0; begin!=end; ++index)
+    // read fields up to the end of the record. the field reader stops
+    // at a delimiter or line end, so the record boundary is found by the
+    // same pass that reads the field values
+    for (unsigned index=0; ; ++index)
     {
-        auto field = detail::read_field(begin, end);
-        fn(index, field.first, field.second);
-        if (begin!=end)
+        bool escaped = false;
+        auto field = detail::read_field<Dialect, InferTypes>(scanner, begin, end, escaped);
+        fn(index, field.first, escaped? type_mask_t(field.second | detail::escaped_flag) : field.second);
+        if (begin == end  ||  *begin != Dialect::delimiter)
+            break;
+        ++begin;
+    }
+
+    assert(begin == end  ||  *begin == '\r'  ||  *begin == '\n');
+    return true;
+}
+
+// read a record, passing the fields that have a target column to the
+// sink, with the index of the target column. other fields are skipped
+template<typename Dialect, typename It, typename Fn>
+inline
+bool const dataset::process_projected_record(detail::basic_structural_scanner<Dialect> &scanner, It &begin, It end, std::vector<int> const &targets, Fn const &fn)
+{
+    for (size_t index=0; ; ++index)
+    {
+        if (index < targets.size()  &&  targets[index] != -1)
         {
-            assert(*begin == ',');
-            ++begin;
+            bool escaped = false;
+            auto field = detail::read_field(scanner, begin, end, escaped);
+            fn(targets[index], field.first, escaped? type_mask_t(field.second | detail::escaped_flag) : field.second);
         }
+        else
+            detail::skip_field(scanner, begin, end);
+
+        if (begin == end  ||  *begin != Dialect::delimiter)
+            break;
+        ++begin;
     }
 
+    assert(begin == end  ||  *begin == '\r'  ||  *begin == '\n');
     return true;
 }
 
@@ -234,7 +520,293 @@ inline void dataset::store_field(unsigned index, string_view const &value, type_
 {
     assert(index < column_info_.size());
 
-    if (type != null_type)
+    widen_column_type(index, type & ~detail::escaped_flag);
+    auto &values = column_values_[index];
+    detail::push_bit(values.valid, values.cells.size(), value.length() != 0);
+    values.cells.push_back(value);
+    if (values.statistics  &&  value.length() != 0)
+        ++values.statistics->count;
+    if (type & detail::escaped_flag)
+        record_escaped(index);
+    store_native_value(index, value, type & ~detail::escaped_flag);
+    assert(column_info_.size() == column_values_.size());
+}
+
+// parse the value of a field of a numeric column into the native values
+// of the column. the native values are discarded if the column becomes
+// a string column, or if a value is out of the range of the native type.
+// nulls before the column type is known are stored as zero when the
+// first value is stored
+inline void dataset::store_native_value(unsigned index, string_view const &value, type_mask_t type)
+{
+    auto &values = column_values_[index];
+    switch (column_info_[index].second)
+    {
+        case integer_type:
+        {
+            std::int64_t number = 0;
+            if (type == integer_type  &&  !detail::parse_integer(value.begin(), value.end(), number))
+            {
+                discard_native_values(index);
+                break;
+            }
+            if (values.integers.empty())
+                values.integers.reserve(std::max(values.reserved, values.cells.size()));
+            values.integers.resize(values.cells.size() - 1);
+            values.integers.push_back(number);
+            if (values.statistics  &&  type == integer_type)
+                values.statistics->add(number);
+            break;
+        }
+
+        case double_type:
+        {
+            double number = 0.0;
+            if (type == double_type  &&  !detail::parse_double(value.begin(), value.end(), number))
+            {
+                discard_native_values(index);
+                break;
+            }
+            if (values.doubles.empty())
+                values.doubles.reserve(std::max(values.reserved, values.cells.size()));
+            values.doubles.resize(values.cells.size() - 1);
+            values.doubles.push_back(number);
+            if (values.statistics  &&  type == double_type)
+                values.statistics->add(number);
+            break;
+        }
+
+        case string_type:
+            if (!values.integers.empty()  ||  !values.doubles.empty())
+                discard_native_values(index);
+            break;
+    }
+}
+
+// parse the native values of a numeric column from its cells. the column
+// is a string column if a value is out of the range of the native type
+inline void dataset::parse_native_values(size_t column)
+{
+    auto &values = column_values_[column];
+    values.integers.clear();
+    values.doubles.clear();
+    switch (column_info_[column].second)
+    {
+        case integer_type:
+            values.integers.resize(values.cells.size());
+            for (size_t loop=0; loop<values.cells.size(); ++loop)
+            {
+                auto const value = values.cells[loop].get<string_view>();
+                if (!detail::parse_integer(value.begin(), value.end(), values.integers[loop])  &&  value.length() != 0)
+                {
+                    discard_native_values(column);
+                    break;
+                }
+            }
+            break;
+
+        case double_type:
+            values.doubles.resize(values.cells.size());
+            for (size_t loop=0; loop<values.cells.size(); ++loop)
+            {
+                auto const value = values.cells[loop].get<string_view>();
+                if (!detail::parse_double(value.begin(), value.end(), values.doubles[loop])  &&  value.length() != 0)
+                {
+                    discard_native_values(column);
+                    break;
+                }
+            }
+            break;
+    }
+
+    if (values.statistics)
+        compute_statistics(column);
+}
+
+// release the native values of a column, which is then a string column
+inline void dataset::discard_native_values(size_t column)
+{
+    auto &values = column_values_[column];
+    column_info_[column].second = string_type;
+    std::vector<std::int64_t>().swap(values.integers);
+    std::vector<double>().swap(values.doubles);
+}
+
+// compute the statistics of a column from its null bitmap and native
+// values, for a column that is decoded or loaded rather than attached
+inline void dataset::compute_statistics(size_t column)
+{
+    auto &values = column_values_[column];
+    values.statistics.reset(new column_statistics_t);
+    auto &statistics = *values.statistics;
+    for (size_t row=0; row<values.cells.size(); ++row)
+    {
+        if (!detail::test_bit(values.valid, row))
+            continue;
+
+        ++statistics.count;
+        if (!values.integers.empty())
+            statistics.add(values.integers[row]);
+        else if (!values.doubles.empty())
+            statistics.add(values.doubles[row]);
+    }
+}
+
+// record that the last cell of a column needs to be unescaped
+inline void dataset::record_escaped(unsigned index)
+{
+    auto &values = column_values_[index];
+    values.escaped.push_back(values.cells.size() - 1);
+    if (!values.unescape_once)
+        values.unescape_once.reset(new std::once_flag);
+    if (!arena_)
+        arena_.reset(new detail::arena);
+}
+
+// unescape the cells of a column that have escaped quotes, the first
+// time the column is accessed. the other cells are not copied
+inline void dataset::unescape_column(size_t column) const
+{
+    auto &values = const_cast<column_values_t &>(column_values_[column]);
+    if (values.unescape_once)
+    {
+        std::call_once(
+            *values.unescape_once,
+            [this, &values]() {
+                for (auto row : values.escaped)
+                    values.cells.set(row, unescape(values.cells[row].get<string_view>()));
+            });
+    }
+}
+
+// returns an unescaped copy of a value, allocated from the arena
+inline string_view const dataset::unescape(string_view const &value) const
+{
+    char *buffer = arena_->allocate(value.length());
+    return string_view(buffer, buffer + detail::unescape(value.begin(), value.end(), quote_, buffer));
+}
+
+// dictionary encode a string column, if it hasn't already been encoded.
+// each distinct value is given a code in the order that it first occurs,
+// and null values have the code null_code. values are compared without
+// case, as they are by string_view. the encoding is abandoned if the
+// column has more than max_dictionary_size distinct values, leaving the
+// codes and dictionary empty
+inline void dataset::encode_column(size_t column) const
+{
+    auto &values = const_cast<column_values_t &>(this->values(column));
+    if (column_type(column) != string_type)
+        return;
+
+    std::call_once(
+        *values.encode_once,
+        [&values]() {
+            std::unordered_map<string_view, std::uint32_t, string_view_hash> lookup;
+            std::vector<std::uint32_t> codes;
+            codes.reserve(values.cells.size());
+            for (size_t row=0; row<values.cells.size(); ++row)
+            {
+                if (!detail::test_bit(values.valid, row))
+                {
+                    codes.push_back(detail::null_code);
+                    continue;
+                }
+
+                auto const inserted = lookup.insert(std::make_pair(values.cells[row].get<string_view>(), std::uint32_t(values.dictionary.size())));
+                if (inserted.second)
+                {
+                    if (values.dictionary.size() == detail::max_dictionary_size)
+                    {
+                        std::vector<string_view>().swap(values.dictionary);
+                        return;
+                    }
+                    values.dictionary.push_back(inserted.first->first);
+                }
+                codes.push_back(inserted.first->second);
+            }
+            values.codes.swap(codes);
+        });
+}
+
+// materialise the non-null values of a numeric column in ascending
+// order, if they haven't already been. the values are cached until the
+// rows are erased, so order statistics of the column are computed
+// without extracting and sorting the column each time
+inline void dataset::materialise_column(size_t column) const
+{
+    auto &values = const_cast<column_values_t &>(this->values(column));
+    std::call_once(
+        *values.materialise_once,
+        [this, column, &values]() {
+            if (column_type(column) == integer_type)
+            {
+                values.sorted_integers = extract_column<std::int64_t>(column, false);
+                std::sort(values.sorted_integers.begin(), values.sorted_integers.end());
+            }
+            else if (column_type(column) == double_type)
+            {
+                values.sorted_doubles = extract_column<double>(column, false);
+                std::sort(values.sorted_doubles.begin(), values.sorted_doubles.end());
+            }
+        });
+}
+
+// store a field of a column with a known type, parsing a numeric value
+// without inferring its type. cells that are not valid for the column
+// type are stored as null values and their positions are recorded
+inline void dataset::store_typed_field(unsigned index, string_view const &value, type_mask_t type, bool nullable)
+{
+    assert(index < column_info_.size());
+    auto &values = column_values_[index];
+
+    bool const escaped = (type & detail::escaped_flag) != 0;
+    type &= ~detail::escaped_flag;
+
+    bool valid = (type != null_type  ||  nullable);
+    switch (column_info_[index].second)
+    {
+        case integer_type:
+        {
+            std::int64_t number = 0;
+            if (type != null_type)
+                valid = detail::parse_integer(value.begin(), value.end(), number);
+            values.integers.push_back(valid? number : 0);
+            if (values.statistics  &&  valid  &&  type != null_type)
+                values.statistics->add(number);
+            break;
+        }
+
+        case double_type:
+        {
+            double number = 0.0;
+            if (type != null_type)
+                valid = detail::parse_double(value.begin(), value.end(), number);
+            values.doubles.push_back(valid? number : 0.0);
+            if (values.statistics  &&  valid  &&  type != null_type)
+                values.statistics->add(number);
+            break;
+        }
+    }
+
+    detail::push_bit(values.valid, values.cells.size(), valid  &&  value.length() != 0);
+    if (values.statistics  &&  valid  &&  value.length() != 0)
+        ++values.statistics->count;
+    if (valid)
+    {
+        values.cells.push_back(value);
+        if (escaped)
+            record_escaped(index);
+    }
+    else
+    {
+        invalid_cells_.push_back(cell_position_t(values.cells.size(), index));
+        values.cells.push_back(string_view(value.begin(), value.begin()));
+    }
+}
+
+inline void dataset::widen_column_type(size_t index, type_mask_t type)
+{
+    if (type != null_type  &&  type != 0)
     {
         // if the column type doesn't match the new type, then
         // the column type will be a string
@@ -243,9 +815,6 @@ inline void dataset::store_field(unsigned index, string_view const &value, type_
         else if (column_info_[index].second != type)
             column_info_[index].second = string_type;
     }
-
-    column_values_[index].emplace_back(value);
-    assert(column_info_.size() == column_values_.size());
 }
 
 inline void dataset::write_column_info(std::ostream &o) const
@@ -271,6 +840,25 @@ inline void dataset::write_column_info(std::ostream &o) const
     serialization free functions
 */
 
+namespace detail {
+
+// write a value between quotes. string values are unescaped, so each
+// quote in the value is escaped again by another quote
+template<typename E, typename T>
+inline void write_quoted(std::basic_ostream<E,T> &o, string_view const &value, char quote)
+{
+    o << quote;
+    for (auto ch : value)
+    {
+        if (ch == quote)
+            o << quote;
+        o << ch;
+    }
+    o << quote;
+}
+
+}   // namespace detail
+
 template<typename E, typename T>
 inline
 std::basic_ostream<E, T> &operator<<(std::basic_ostream<E,T> &o, dataset::row_data::cell_reference const &value)
@@ -279,9 +867,9 @@ std::basic_ostream<E, T> &operator<<(std::basic_ostream<E,T> &o, dataset::row_da
     {
         switch (value.type())
         {
-            case string_type:   o << value.get<std::string>();      break;  /// !!! escape " quote with "" 
+            case string_type:   detail::write_quoted(o, value.get<string_view>(), value.quote());  break;
             case double_type:   o << value.get<double>();           break;
-            case integer_type:  o << value.get<std::uint32_t>();    break;
+            case integer_type:  o << value.get<std::int64_t>();     break;
             default:            assert(!"Unknown value type");
         }
     }
@@ -300,12 +888,7 @@ std::basic_ostream<E,T> &operator<<(std::basic_ostream<E,T> &o, dataset::row_dat
             first = false;
         else
             o << ',';
-
-        auto const &value = row[loop];
-        if (value.type() == string_type)
-            o << '\"' << value << '\"';
-        else
-            o << value;
+        o << row[loop];
     }
     return o;
 }
@@ -321,7 +904,7 @@ std::basic_ostream<E,T> &operator<<(std::basic_ostream<E,T> &o, dataset const &d
             first = false;
         else
             o << ',';
-        o << '\"' << column.first << '\"';
+        detail::write_quoted(o, column.first, dd.quote_);
     }
     o << "\n";
 
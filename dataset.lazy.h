@@ -0,0 +1,185 @@
+// Copyright (c) 2013 Craig Henderson
+// Part of the Data Processing Library
+// https://github.com/cdmh/dataproc
+
+#pragma once
+
+#include <limits>
+
+namespace cdmh {
+namespace data_processing {
+
+// attach to a buffer of CSV records without reading the fields. the
+// header is read, and the records are scanned for line ends to index the
+// offset of each record. a column is decoded when it is first accessed,
+// and a row is decoded when a cell of an undecoded column is accessed,
+// so exploring a few columns or rows of a large file doesn't read the
+// whole file. the buffer must remain valid while the dataset is in use
+template<typename Dialect>
+inline bool const dataset::attach_lazy(char const *begin, char const *end)
+{
+    auto const data = begin;
+    detail::basic_structural_scanner<Dialect> scanner(end);
+    attach_header(scanner, begin, end);
+
+    lazy_.reset(new lazy_index_t);
+    arena_.reset(new detail::arena);
+    lazy_->begin         = data;
+    lazy_->end           = end;
+    lazy_->decode_column = &dataset::decode_lazy_column<Dialect>;
+    lazy_->decode_row    = &dataset::decode_lazy_row<Dialect>;
+    lazy_->decoded.resize(columns(), false);
+    lazy_->row           = std::numeric_limits<size_t>::max();
+    for (size_t loop=0; loop<columns(); ++loop)
+        lazy_->fields.push_back(loop);
+
+    bool const wide = std::uint64_t(end - data) > std::numeric_limits<std::uint32_t>::max();
+    auto const estimate = detail::estimate_records(begin, end);
+    if (wide)
+        lazy_->offsets64.reserve(estimate);
+    else
+        lazy_->offsets32.reserve(estimate);
+    while (detail::skip_blank<Dialect>(begin, end) != end)
+    {
+        if (wide)
+            lazy_->offsets64.push_back(begin - data);
+        else
+            lazy_->offsets32.push_back(std::uint32_t(begin - data));
+        begin = detail::find_record_end(scanner, begin, end);
+    }
+    return true;
+}
+
+inline char const *dataset::record_start(size_t row) const
+{
+    assert(lazy_  &&  row < rows());
+    if (lazy_->offsets64.empty())
+        return lazy_->begin + lazy_->offsets32[row];
+    return lazy_->begin + lazy_->offsets64[row];
+}
+
+// decode a column of a lazily attached dataset, if it hasn't already
+// been decoded. decoding is serialised, so columns can be accessed from
+// many threads
+inline void dataset::decode_column(size_t column) const
+{
+    if (!lazy_)
+        return;
+
+    std::lock_guard<std::mutex> lock(lazy_->mutex);
+    if (!lazy_->decoded[column])
+    {
+        // the column values are a cache of the records, so are
+        // updated by const member functions
+        lazy_->decode_column(const_cast<dataset &>(*this), column);
+        lazy_->decoded[column] = true;
+    }
+}
+
+// returns a cell of a lazily attached dataset. if the column hasn't been
+// decoded, the row is decoded and replaces the row that was cached, so
+// that the rest of the row can be accessed without reading the record
+// again. the cells refer to the buffer, or to the buffer of the cached
+// row for unescaped values, so an unescaped value that has been returned
+// is valid until another row is decoded
+inline dataset::cell_value const dataset::decode_cell(size_t row, size_t column) const
+{
+    std::lock_guard<std::mutex> lock(lazy_->mutex);
+    if (lazy_->decoded[column])
+        return column_values_[column].cells[row];
+
+    if (lazy_->row != row)
+    {
+        lazy_->row = std::numeric_limits<size_t>::max();
+        lazy_->row_cells.clear();
+        lazy_->decode_row(const_cast<dataset &>(*this), row, lazy_->row_cells);
+        lazy_->row = row;
+    }
+
+    auto const field = lazy_->fields[column];
+    return (field < lazy_->row_cells.size())? lazy_->row_cells[field] : cell_value(string_view(""));
+}
+
+template<typename Dialect>
+inline void dataset::decode_lazy_column(dataset &ds, size_t column)
+{
+    auto const field = ds.lazy_->fields[column];
+    auto const end   = ds.lazy_->end;
+    auto const rows  = ds.rows();
+    auto      &cells = ds.column_values_[column].cells;
+    auto      &valid = ds.column_values_[column].valid;
+    cells.reserve(rows);
+
+    detail::basic_structural_scanner<Dialect> scanner(end);
+    for (size_t row=0; row<rows; ++row)
+    {
+        // skip the fields before the column. a short record has
+        // a null value
+        auto it = ds.record_start(row);
+        size_t index = 0;
+        for (; index<field; ++index)
+        {
+            detail::skip_field(scanner, it, end);
+            if (it == end  ||  *it != Dialect::delimiter)
+                break;
+            ++it;
+        }
+
+        if (index < field)
+        {
+            detail::push_bit(valid, row, false);
+            cells.push_back(string_view(""));
+        }
+        else
+        {
+            bool escaped = false;
+            auto const value = detail::read_field(scanner, it, end, escaped);
+            ds.widen_column_type(column, value.second);
+            detail::push_bit(valid, row, value.first.length() != 0);
+            // the raw value is stored first so that the cell is
+            // relative to the attached buffer rather than the arena
+            cells.push_back(value.first);
+            if (escaped)
+                cells.set(row, ds.unescape(value.first));
+        }
+    }
+    ds.parse_native_values(column);
+}
+
+template<typename Dialect>
+inline void dataset::decode_lazy_row(dataset &ds, size_t row, std::vector<cell_value> &cells)
+{
+    // the escaped values are unescaped into the buffer of the row, which
+    // is reused for the next row rather than allocated from the arena.
+    // a value is no longer when it is unescaped, so the buffer is sized
+    // by the escaped values and isn't reallocated as they are copied
+    auto it = ds.record_start(row);
+    auto &escaped = ds.lazy_->row_escaped;
+    escaped.clear();
+    size_t length = 0;
+    detail::basic_structural_scanner<Dialect> scanner(ds.lazy_->end);
+    ds.process_record(
+        scanner, it, ds.lazy_->end,
+        [&cells, &escaped, &length](unsigned index, string_view const &value, type_mask_t type) {
+            if (type & detail::escaped_flag)
+            {
+                escaped.push_back(index);
+                length += value.length();
+            }
+            cells.emplace_back(value);
+        });
+
+    auto &buffer = ds.lazy_->row_buffer;
+    buffer.resize(length);
+    char *out = buffer.data();
+    for (auto index : escaped)
+    {
+        auto const value = cells[index].get<string_view>();
+        char *const begin = out;
+        out += detail::unescape(value.begin(), value.end(), ds.quote_, begin);
+        cells[index] = cell_value(string_view(begin, out));
+    }
+}
+
+}   // namespace data_processing
+}   // namespace cdmh
@@ -0,0 +1,196 @@
+// Copyright (c) 2013 Craig Henderson
+// Part of the Data Processing Library
+// https://github.com/cdmh/dataproc
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+
+namespace cdmh {
+namespace data_processing {
+
+// attach to a buffer of CSV records, reading the records concurrently.
+// the buffer is split into a chunk per thread at record boundaries, each
+// chunk is read into a partial dataset, and the partial datasets are then
+// appended in order. the column types are the same as a serial attach
+template<typename Dialect>
+inline bool const dataset::attach_parallel(char const *begin, char const *end, unsigned thread_count)
+{
+    // a minimum chunk size stops small buffers being split needlessly
+    size_t const min_chunk_size = 64 * 1024;
+
+    if (thread_count == 0)
+        thread_count = std::max(1U, std::thread::hardware_concurrency());
+
+    detail::basic_structural_scanner<Dialect> scanner(end);
+    attach_header(scanner, begin, end);
+    if (detail::skip_blank<Dialect>(begin, end) == end)
+        return true;
+
+    unsigned const chunk_count = (unsigned)std::min<size_t>(thread_count, (end - begin) / min_chunk_size + 1);
+    auto const boundaries = detail::split_records<Dialect>(begin, end, chunk_count);
+
+    std::vector<dataset> parts(chunk_count);
+    std::vector<std::thread> threads;
+    for (unsigned loop=0; loop<chunk_count; ++loop)
+    {
+        parts[loop].create_columns(*this);
+        threads.emplace_back(
+            [&parts, &boundaries, loop]() {
+                auto it = boundaries[loop];
+                detail::basic_structural_scanner<Dialect> scanner(boundaries[loop+1]);
+                parts[loop].reserve_records<Dialect>(it, boundaries[loop+1], 0);
+                parts[loop].attach_records(scanner, it, boundaries[loop+1], 0);
+            });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    for (auto &part : parts)
+        append(std::move(part));
+
+    return true;
+}
+
+// attach to a list of CSV files that have the same header, reading
+// the files concurrently into one dataset. the files are memory mapped
+// and held by the dataset, and the cells refer to the mapped files, so
+// no record data is copied. returns false if a file cannot be opened
+template<typename Dialect>
+inline bool const dataset::attach_files(std::vector<std::string> const &filenames, unsigned thread_count)
+{
+    assert(!is_attached());
+
+    std::vector<std::unique_ptr<memory_mapped_file<char>>> files;
+    for (auto const &filename : filenames)
+    {
+        files.emplace_back(new memory_mapped_file<char>(filename));
+        if (!files.back()->is_open())
+            return false;
+    }
+    if (files.empty())
+        return true;
+
+    if (thread_count == 0)
+        thread_count = std::max(1U, std::thread::hardware_concurrency());
+
+    // each thread takes the next file to be read until all are read
+    std::vector<dataset> parts(files.size());
+    for (auto &part : parts)
+        part.collect_statistics(collect_statistics_);
+    std::atomic<size_t> next_file(0);
+    std::vector<std::thread> threads;
+    for (size_t loop=0; loop<std::min<size_t>(thread_count, files.size()); ++loop)
+    {
+        threads.emplace_back(
+            [&parts, &files, &next_file]() {
+                for (size_t index; (index = next_file++) < files.size(); )
+                {
+                    char const *data = files[index]->get();
+                    parts[index].attach<Dialect>(data, data + files[index]->size());
+                }
+            });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    for (auto const &part : parts)
+    {
+        if (!part.same_columns(parts[0]))
+            throw header_mismatch();
+    }
+
+    create_columns(parts[0]);
+    for (auto &part : parts)
+        append(std::move(part));
+    for (auto &file : files)
+        files_.push_back(std::move(file));
+    return true;
+}
+
+// returns true if the column names are the same as another dataset
+inline bool const dataset::same_columns(dataset const &other) const
+{
+    if (column_info_.size() != other.column_info_.size())
+        return false;
+
+    for (size_t loop=0; loop<column_info_.size(); ++loop)
+    {
+        if (!(column_info_[loop].first == other.column_info_[loop].first))
+            return false;
+    }
+    return true;
+}
+
+// append the rows of a dataset with the same columns, widening the
+// column types to include the types of the appended rows
+inline void dataset::append(dataset &&other)
+{
+    assert(other.columns() == columns());
+    for (size_t loop=0; loop<columns(); ++loop)
+    {
+        widen_column_type(loop, other.column_info_[loop].second);
+
+        auto &values = column_values_[loop];
+        auto &other_values = other.column_values_[loop];
+        if (values.cells.empty())
+            values = std::move(other_values);
+        else
+        {
+            // the rows of escaped cells are offset by the existing rows
+            for (auto row : other_values.escaped)
+                values.escaped.push_back(values.cells.size() + row);
+            if (!values.escaped.empty()  &&  !values.unescape_once)
+                values.unescape_once.reset(new std::once_flag);
+
+            // a column that has only nulls in either dataset has
+            // no native values, so zeros are stored for its rows
+            size_t const rows       = values.cells.size();
+            size_t const other_rows = other_values.cells.size();
+            switch (column_info_[loop].second)
+            {
+                case integer_type:
+                    values.integers.resize(rows);
+                    values.integers.insert(values.integers.end(), other_values.integers.begin(), other_values.integers.end());
+                    values.integers.resize(rows + other_rows);
+                    break;
+
+                case double_type:
+                    values.doubles.resize(rows);
+                    values.doubles.insert(values.doubles.end(), other_values.doubles.begin(), other_values.doubles.end());
+                    values.doubles.resize(rows + other_rows);
+                    break;
+
+                default:
+                    std::vector<std::int64_t>().swap(values.integers);
+                    std::vector<double>().swap(values.doubles);
+                    break;
+            }
+            detail::append_bits(values.valid, rows, other_values.valid, other_rows);
+            values.cells.append(other_values.cells);
+            if (values.statistics  &&  other_values.statistics)
+                values.statistics->merge(*other_values.statistics);
+            else
+                values.statistics.reset();
+        }
+    }
+    other.column_values_.clear();
+    other.column_info_.clear();
+    if (other.arena_  &&  !arena_)
+        arena_.reset(new detail::arena);
+}
+
+// create empty columns with the same names as another dataset, which
+// collect statistics if the other dataset does
+inline void dataset::create_columns(dataset const &other)
+{
+    assert(!is_attached());
+    quote_              = other.quote_;
+    collect_statistics_ = other.collect_statistics_;
+    for (auto const &column : other.column_info_)
+        create_column((unsigned)columns(), column.first, 0);
+}
+
+}   // namespace data_processing
+}   // namespace cdmh
@@ -63,5 +63,11 @@ inline type_mask_t const dataset::row_data::cell_reference::type() const
     return dd_.column_type(column_);
 }
 
+// the quote character of the dialect that the dataset was read with
+inline char const dataset::row_data::cell_reference::quote() const
+{
+    return dd_.quote_;
+}
+
 }   // namespace data_processing
 }   // namespace cdmh
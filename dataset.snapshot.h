@@ -0,0 +1,300 @@
+// Copyright (c) 2013 Craig Henderson
+// Part of the Data Processing Library
+// https://github.com/cdmh/dataproc
+
+// A columnar binary snapshot of a dataset, which is memory mapped and
+// used in place, so that a dataset can be reloaded without reading the
+// CSV records again.
+//
+// The file starts with a snapshot_header, which is followed by the
+// sections of each column and then a directory of snapshot_column
+// entries. Each section starts on an 8 byte boundary. A column has
+//  - its name
+//  - a heap of its values, each followed by a nul character so that a
+//    value isn't parsed into the next
+//  - a cell for each row, which is a 32 bit offset into the heap and a
+//    32 bit length, or a 64 bit offset and length if the heap is 4GB or
+//    larger. a null value has a length of zero
+//  - a bitmap with a bit set for each row that isn't null
+//  - the native value of each row of a numeric column
+// Values are stored in the byte order of the machine that saved the
+// snapshot.
+
+#pragma once
+
+#include <fstream>
+
+namespace cdmh {
+namespace data_processing {
+namespace detail {
+
+struct snapshot_header
+{
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t quote;
+    std::uint64_t rows;
+    std::uint64_t columns;
+    std::uint64_t directory_offset;
+    std::uint64_t invalid_cells;            // the number of invalid cells
+    std::uint64_t invalid_cells_offset;     // a row and column for each
+};
+
+struct snapshot_column
+{
+    std::uint64_t name_offset;
+    std::uint64_t name_length;
+    std::uint64_t heap_offset;
+    std::uint64_t heap_length;
+    std::uint64_t cells_offset;
+    std::uint64_t valid_offset;
+    std::uint64_t native_offset;            // zero if there are no native values
+    std::uint32_t type;
+    std::uint32_t cell_width;               // 8 or 16 bytes
+};
+
+static char          const snapshot_magic[8] = { 'D', 'P', 'S', 'N', 'A', 'P', '\0', '\0' };
+static std::uint32_t const snapshot_version  = 1;
+
+// write a section at the next 8 byte boundary, returns its offset
+inline std::uint64_t const write_snapshot_section(std::ofstream &file, void const *data, size_t size)
+{
+    static char const padding[8] = { 0 };
+    std::uint64_t const position = file.tellp();
+    file.write(padding, (8 - position % 8) % 8);
+
+    std::uint64_t const offset = file.tellp();
+    if (size > 0)
+        file.write(static_cast<char const *>(data), size);
+    return offset;
+}
+
+}   // namespace detail
+
+// save the dataset as a snapshot file, which can be opened with
+// open_snapshot. escaped values are saved unescaped
+inline void dataset::save_snapshot(std::string const &filename) const
+{
+    std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("Failed to create snapshot file");
+
+    detail::snapshot_header header = { };
+    std::copy(detail::snapshot_magic, detail::snapshot_magic + sizeof(header.magic), header.magic);
+    header.version = detail::snapshot_version;
+    header.quote   = std::uint32_t(quote_);
+    header.rows    = rows();
+    header.columns = columns();
+    file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+
+    std::vector<detail::snapshot_column> directory(columns());
+    for (size_t column=0; column<columns(); ++column)
+    {
+        auto const &values = this->values(column);
+        auto const &name   = column_info_[column].first;
+        auto       &entry  = directory[column];
+        entry.type        = column_info_[column].second;
+        entry.name_offset = detail::write_snapshot_section(file, name.begin(), name.length());
+        entry.name_length = name.length();
+
+        // the values are written to the heap as the offsets of the cells
+        // are collected, and the cells are written after the heap
+        std::uint64_t heap_length = 0;
+        for (auto const &cell : values.cells)
+        {
+            auto const length = cell.get<string_view>().length();
+            heap_length += (length == 0)? 0 : length + 1;
+        }
+        entry.cell_width = (heap_length <= std::numeric_limits<std::uint32_t>::max())? 8 : 16;
+
+        std::vector<std::uint32_t> narrow;
+        std::vector<std::uint64_t> wide;
+        std::vector<char>          buffer;
+        entry.heap_offset = detail::write_snapshot_section(file, nullptr, 0);
+        entry.heap_length = heap_length;
+        std::uint64_t offset = 0;
+        for (auto const &cell : values.cells)
+        {
+            auto const value = cell.get<string_view>();
+            if (entry.cell_width == 8)
+            {
+                narrow.push_back(std::uint32_t(offset));
+                narrow.push_back(std::uint32_t(value.length()));
+            }
+            else
+            {
+                wide.push_back(offset);
+                wide.push_back(value.length());
+            }
+            if (value.length() > 0)
+            {
+                buffer.insert(buffer.end(), value.begin(), value.end());
+                buffer.push_back('\0');
+                offset += value.length() + 1;
+            }
+
+            if (buffer.size() >= 1024 * 1024)
+            {
+                file.write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        }
+        file.write(buffer.data(), buffer.size());
+
+        if (entry.cell_width == 8)
+            entry.cells_offset = detail::write_snapshot_section(file, narrow.data(), narrow.size() * sizeof(std::uint32_t));
+        else
+            entry.cells_offset = detail::write_snapshot_section(file, wide.data(), wide.size() * sizeof(std::uint64_t));
+        entry.valid_offset = detail::write_snapshot_section(file, values.valid.data(), values.valid.size() * sizeof(std::uint64_t));
+
+        if (!values.integers.empty())
+            entry.native_offset = detail::write_snapshot_section(file, values.integers.data(), values.integers.size() * sizeof(std::int64_t));
+        else if (!values.doubles.empty())
+            entry.native_offset = detail::write_snapshot_section(file, values.doubles.data(), values.doubles.size() * sizeof(double));
+    }
+
+    std::vector<std::uint64_t> invalid_cells;
+    for (auto const &position : invalid_cells_)
+    {
+        invalid_cells.push_back(position.first);
+        invalid_cells.push_back(position.second);
+    }
+    header.invalid_cells        = invalid_cells_.size();
+    header.invalid_cells_offset = detail::write_snapshot_section(file, invalid_cells.data(), invalid_cells.size() * sizeof(std::uint64_t));
+    header.directory_offset     = detail::write_snapshot_section(file, directory.data(), directory.size() * sizeof(detail::snapshot_column));
+
+    file.seekp(0);
+    file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    if (!file)
+        throw std::runtime_error("Failed to write snapshot file");
+}
+
+// open a snapshot saved by save_snapshot. the file is memory mapped and
+// held by the dataset. the column names and cells refer to the mapped
+// file, so no values are parsed; the null bitmaps and native values are
+// copied into the columns. the sections of the file are checked to be
+// within the file, and each cell is checked to be a value within the
+// heap of its column that is followed by a nul character. returns false
+// if the file cannot be opened, and throws invalid_snapshot if the file
+// isn't a valid snapshot of this version
+inline bool const dataset::open_snapshot(std::string const &filename)
+{
+    assert(!is_attached());
+
+    std::unique_ptr<memory_mapped_file<char>> file(new memory_mapped_file<char>(filename));
+    if (!file->is_open())
+        return false;
+
+    char const *const data = file->get();
+    std::uint64_t const size = file->size();
+    auto const section = [data, size](std::uint64_t offset, std::uint64_t count, size_t element_size) -> char const * {
+        if (offset > size  ||  count > (size - offset) / element_size)
+            throw invalid_snapshot();
+        return data + offset;
+    };
+
+    detail::snapshot_header header;
+    memcpy(&header, section(0, 1, sizeof(header)), sizeof(header));
+    if (memcmp(header.magic, detail::snapshot_magic, sizeof(header.magic)) != 0  ||  header.version != detail::snapshot_version)
+        throw invalid_snapshot();
+
+    size_t const rows  = (size_t)header.rows;
+    size_t const words = (rows + 63) / 64;
+    auto const directory = reinterpret_cast<detail::snapshot_column const *>(
+        section(header.directory_offset, header.columns, sizeof(detail::snapshot_column)));
+
+    try
+    {
+        quote_ = char(header.quote);
+        for (size_t column=0; column<header.columns; ++column)
+        {
+            auto const &entry = directory[column];
+            auto const  name  = section(entry.name_offset, entry.name_length, 1);
+            column_info_.push_back(column_info_t(string_view(name, name + entry.name_length), type_mask_t(entry.type)));
+            column_values_.push_back(column_values_t());
+            auto &values = column_values_.back();
+
+            // a value that isn't empty is followed by a nul character within
+            // the heap, which also keeps a narrow cell's length below the
+            // length of a cell that refers to another value
+            auto const heap = section(entry.heap_offset, entry.heap_length, 1);
+            auto const check_cell = [heap, &entry](std::uint64_t offset, std::uint64_t length) {
+                if (length != 0  &&  (offset >= entry.heap_length  ||  length >= entry.heap_length - offset  ||  heap[offset + length] != '\0'))
+                    throw invalid_snapshot();
+            };
+            if (entry.cell_width == 8  &&  entry.heap_length <= std::numeric_limits<std::uint32_t>::max())
+            {
+                auto const cells = reinterpret_cast<std::uint32_t const *>(section(entry.cells_offset, rows, 8));
+                for (size_t row=0; row<rows; ++row)
+                    check_cell(cells[row*2], cells[row*2+1]);
+                values.cells.attach_view(heap, (size_t)entry.heap_length, cells, rows);
+            }
+            else if (entry.cell_width == 16)
+            {
+                auto const cells = reinterpret_cast<std::uint64_t const *>(section(entry.cells_offset, rows, 16));
+                values.cells.reserve(rows);
+                for (size_t row=0; row<rows; ++row)
+                {
+                    check_cell(cells[row*2], cells[row*2+1]);
+                    auto const value = heap + ((cells[row*2+1] == 0)? 0 : cells[row*2]);
+                    values.cells.push_back(string_view(value, value + cells[row*2+1]));
+                }
+            }
+            else
+                throw invalid_snapshot();
+
+            // bits after the last row would select native values that
+            // don't exist
+            auto const valid = reinterpret_cast<std::uint64_t const *>(section(entry.valid_offset, words, sizeof(std::uint64_t)));
+            values.valid.assign(valid, valid + words);
+            if (rows % 64 != 0)
+                values.valid.back() &= (std::uint64_t(1) << (rows % 64)) - 1;
+
+            // a numeric column with values has native values, and other
+            // columns have none
+            bool const numeric = (entry.type == integer_type  ||  entry.type == double_type);
+            bool const has_values = std::find_if(values.valid.begin(), values.valid.end(), [](std::uint64_t word) { return word != 0; }) != values.valid.end();
+            if ((numeric  &&  entry.native_offset == 0  &&  has_values)  ||  (!numeric  &&  entry.native_offset != 0))
+                throw invalid_snapshot();
+
+            if (entry.native_offset != 0  &&  entry.type == integer_type)
+            {
+                auto const integers = reinterpret_cast<std::int64_t const *>(section(entry.native_offset, rows, sizeof(std::int64_t)));
+                values.integers.assign(integers, integers + rows);
+            }
+            else if (entry.native_offset != 0  &&  entry.type == double_type)
+            {
+                auto const doubles = reinterpret_cast<double const *>(section(entry.native_offset, rows, sizeof(double)));
+                values.doubles.assign(doubles, doubles + rows);
+            }
+
+            if (collect_statistics_)
+                compute_statistics(column);
+        }
+
+        auto const invalid_cells = reinterpret_cast<std::uint64_t const *>(
+            section(header.invalid_cells_offset, header.invalid_cells, 2 * sizeof(std::uint64_t)));
+        for (size_t loop=0; loop<header.invalid_cells; ++loop)
+        {
+            if (invalid_cells[loop*2] >= header.rows  ||  invalid_cells[loop*2+1] >= header.columns)
+                throw invalid_snapshot();
+            invalid_cells_.push_back(cell_position_t((size_t)invalid_cells[loop*2], (size_t)invalid_cells[loop*2+1]));
+        }
+    }
+    catch (invalid_snapshot const &)
+    {
+        // the columns refer to the file, which is unmapped as this
+        // returns, so they are removed and the dataset can be used again
+        column_info_.clear();
+        column_values_.clear();
+        invalid_cells_.clear();
+        quote_ = '"';
+        throw;
+    }
+
+    files_.push_back(std::move(file));
+    return true;
+}
+
+}   // namespace data_processing
+}   // namespace cdmh
@@ -15,112 +15,312 @@ unsigned const bit_count(T n)
     return (((n + (n >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
 }
 
+// returns the type of an unquoted field value that has been trimmed.
+// the value is classified by a state machine with a table lookup per
+// character, rather than branching on each character
 inline
-std::pair<string_view, type_mask_t>
-read_field(char const *&begin, char const *end)
+type_mask_t const field_type(char const *it, char const *end)
 {
-    assert(begin != end);
+    // character classes: 0 other, 1 digit, 2 sign, 3 period
+    static unsigned char const char_class[256] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 2, 3, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+
+    enum state { start, sign, integer, period, fraction, string, state_count };
+    static unsigned char const transitions[state_count][4] = {
+        //  other   digit     sign    period
+        {  string, integer,   sign,   period },    // start
+        {  string, integer,   string, period },    // sign
+        {  string, integer,   string, fraction },  // integer, e.g. 12 or -12
+        {  string, fraction,  string, string },    // period, e.g. . or -.
+        {  string, fraction,  string, string },    // fraction, e.g. 1.2 or .2 or 1.
+        {  string, string,    string, string },    // string
+    };
 
-    // we'll trim spaces before any quotes, but not within quotes
-    ltrim(begin, end);
+    static type_mask_t const types[state_count] = {
+        null_type, string_type, integer_type, string_type, double_type, string_type
+    };
+
+    unsigned char current = start;
+    for (; it != end  &&  current != string; ++it)
+        current = transitions[current][char_class[(unsigned char)*it]];
+
+    return types[current];
+}
 
-    bool in_quotes  = false;
-    if (*begin == '\"')
+// set in the type passed to a record sink for a quoted field that
+// contains escaped quotes, and so needs to be unescaped
+static type_mask_t const escaped_flag = 1 << 7;
+
+// returns the closing quote of a quoted field that starts at 'it'.
+// inside quotes, a pair of quotes is an escaped quote
+template<typename Dialect>
+inline
+char const *find_closing_quote(basic_structural_scanner<Dialect> &scanner, char const *it, char const *end, bool &escaped)
+{
+    for (;;)
     {
-        in_quotes = true;
+        it = scanner.find_quote(it);
+        if (it == end  ||  it+1 == end  ||  *(it+1) != Dialect::quote)
+            break;
+        it += 2;
+        escaped = true;
+    }
+
+    assert(it != end  &&  "Unterminated quoted field");
+    return it;
+}
+
+template<typename Dialect>
+inline
+char const *find_closing_quote(basic_structural_scanner<Dialect> &scanner, char const *it, char const *end)
+{
+    bool escaped = false;
+    return find_closing_quote(scanner, it, end, escaped);
+}
+
+// copy a quoted field value, replacing each pair of quotes with a
+// single quote. returns the length of the unescaped value
+inline
+size_t const unescape(char const *it, char const *end, char quote, char *out)
+{
+    char *const begin = out;
+    for (; it != end; ++it)
+    {
+        *out++ = *it;
+        if (*it == quote  &&  it+1 != end  &&  *(it+1) == quote)
+            ++it;
+    }
+    return out - begin;
+}
+
+// read a field from the record, using the structural scanner to
+// find the closing quote or the delimiter that ends the field. if
+// InferTypes is false, the type is null_type or string_type only.
+// 'escaped' is set if the field is quoted and contains escaped quotes.
+// the field value is not unescaped
+template<typename Dialect, bool InferTypes=true>
+inline
+std::pair<string_view, type_mask_t>
+read_field(basic_structural_scanner<Dialect> &scanner, char const *&begin, char const *end, bool &escaped)
+{
+    // we'll trim spaces before any quotes, but not within quotes. line
+    // ends are not trimmed, they are left for the caller to detect the
+    // end of the record
+    while (begin != end  &&  Dialect::is_padding(*begin))
+        ++begin;
+
+    if (begin != end  &&  *begin == Dialect::quote)
+    {
+        auto it = find_closing_quote(scanner, ++begin, end, escaped);
+        auto result = std::make_pair(string_view(begin, it), (begin == it)? null_type : string_type);
+
+        // update returning 'begin' iterator to the start next field,
+        // skipping padding between the closing quote and the delimiter
+        begin = it;
+        if (begin != end)
+            ++begin;
+        while (begin != end  &&  Dialect::is_padding(*begin))
+            ++begin;
+        return result;
+    }
+
+    // outside quotes, terminate on delimiter or CR or LF. the field value
+    // excludes trailing spaces, but the returning 'begin' iterator is
+    // updated to the delimiter
+    auto it = scanner.find_field_end(begin);
+    auto field_end = it;
+    rtrim(begin, field_end);
+
+    type_mask_t const type = InferTypes? field_type(begin, field_end) : ((begin == field_end)? null_type : string_type);
+    auto result = std::make_pair(string_view(begin, field_end), type);
+    begin = it;
+    return result;
+}
+
+template<typename Dialect, bool InferTypes=true>
+inline
+std::pair<string_view, type_mask_t>
+read_field(basic_structural_scanner<Dialect> &scanner, char const *&begin, char const *end)
+{
+    bool escaped = false;
+    return read_field<Dialect, InferTypes>(scanner, begin, end, escaped);
+}
+
+// skip a field without reading its value. 'begin' is updated to the
+// delimiter or line end, in the same way as read_field
+template<typename Dialect>
+inline
+void skip_field(basic_structural_scanner<Dialect> &scanner, char const *&begin, char const *end)
+{
+    while (begin != end  &&  Dialect::is_padding(*begin))
         ++begin;
+
+    if (begin != end  &&  *begin == Dialect::quote)
+    {
+        begin = find_closing_quote(scanner, begin+1, end);
+        if (begin != end)
+            ++begin;
+        while (begin != end  &&  Dialect::is_padding(*begin))
+            ++begin;
     }
+    else
+        begin = scanner.find_field_end(begin);
+}
 
-    auto it = begin;
-    type_mask_t incl_type_mask = string_type;
-    type_mask_t excl_type_mask = 0;
+// returns the line end of the record that starts at 'it', or end. the
+// fields are not read; quoted fields are skipped so that line ends in
+// quotes are not mistaken for the end of the record
+template<typename Dialect>
+inline
+char const *find_record_end(basic_structural_scanner<Dialect> &scanner, char const *it, char const *end)
+{
+    for (;;)
+    {
+        it = scanner.find_line_end_or_quote(it);
+        if (it == end  ||  *it != Dialect::quote)
+            return it;
 
-    // special case for unary operators
-    if (!in_quotes  &&  (*it == '-'  ||  *it == '+'))
+        it = find_closing_quote(scanner, it+1, end);
+        if (it != end)
+            ++it;
+    }
+}
+
+template<typename Dialect>
+inline
+std::pair<string_view, type_mask_t>
+read_field(char const *&begin, char const *end)
+{
+    basic_structural_scanner<Dialect> scanner(end);
+    return read_field(scanner, begin, end);
+}
+
+inline
+std::pair<string_view, type_mask_t>
+read_field(char const *&begin, char const *end)
+{
+    return read_field<csv_dialect>(begin, end);
+}
+
+// returns the start of the first record that begins at or after 'it'.
+// 'in_quotes' is the quote state at 'it', so that line ends within
+// quoted fields are not mistaken for the end of a record
+template<typename Dialect>
+inline
+char const *find_record_start(char const *it, char const *end, bool in_quotes)
+{
+    for (; it != end; ++it)
     {
-        incl_type_mask |= double_type | integer_type;
-        ++it;
+        if (*it == Dialect::quote)
+            in_quotes = !in_quotes;
+        else if (!in_quotes  &&  (*it == '\r'  ||  *it == '\n'))
+            break;
     }
+    return skip_blank<Dialect>(it, end);
+}
 
-    bool seen_period = false;
-    bool seen_space  = false;
-    for (;
-        it!=end
-        &&  (
-            (in_quotes  &&  *it != '\"')
-        ||  (in_quotes  &&  *it == '\"'  &&  it+1!=end  &&  *(it+1) == '\"')   // inside quotes, "" escaped quotes
-        ||  (!in_quotes  &&  *it != ','  &&  *it != '\r'  &&  *it != '\n')     // outside quotes, terminate on comma or CR or LF
-        );
-        ++it)
+// estimate the number of records in a buffer from the mean length of a
+// sample of records at evenly spaced positions. the records are found by
+// their line ends alone, so that a sample position within a quoted field
+// is harmless, and the estimate is a guide for reserving storage rather
+// than an exact count
+inline
+size_t const estimate_records(char const *begin, char const *end)
+{
+    unsigned const sample_positions   = 16;
+    unsigned const records_per_sample = 16;
+
+    size_t records = 0;
+    size_t length  = 0;
+    for (unsigned position=0; position<sample_positions; ++position)
     {
-        if (in_quotes)
+        char const *it = begin + (end - begin) / sample_positions * position;
+        if (position != 0)
         {
-            if (*it == '\"')
-            {
-                assert(it+1 != end);
-                assert(*(it+1) == '\"');
-                ++it;
-            }
+            it = static_cast<char const *>(memchr(it, '\n', end - it));
+            if (it == nullptr)
+                break;
+            ++it;
         }
-        else
+
+        for (unsigned loop=0; loop<records_per_sample  &&  it != end; ++loop)
         {
-            if (*it >= '0'  &&  *it <= '9')
-            {
-                if (seen_space)
-                    excl_type_mask |= double_type | integer_type;
-                else
-                    incl_type_mask |= double_type | integer_type;
-            }
-            else if (*it == '.')
-            {
-                if (seen_space)
-                    excl_type_mask |= double_type | integer_type;
-                else if (seen_period)
-                    excl_type_mask |= double_type;
-                else
-                {
-                    incl_type_mask |= double_type;
-                    excl_type_mask |= integer_type;
-                    seen_period = true;
-                }
-            }
-            else if (*it != '\r'  &&  *it != '\n')
-            {
-                assert(!in_quotes);
-                if (isspace(*it))
-                    seen_space = true;
-                else
-                    excl_type_mask |= double_type | integer_type;
-            }
+            auto next = static_cast<char const *>(memchr(it, '\n', end - it));
+            next = (next == nullptr)? end : next + 1;
+            length += next - it;
+            ++records;
+            it = next;
         }
     }
 
-    if (!in_quotes)
-        rtrim(begin, it);
+    if (records == 0)
+        return 0;
+    return size_t((end - begin) / (double(length) / records)) + 1;
+}
 
-    if (begin == it)
-        return std::make_pair(string_view(begin, it), null_type);
+// split a buffer of records into 'count' chunks that each start at a
+// record boundary. the quotes in each chunk are counted concurrently,
+// and the parity of the quotes before a chunk tells us whether the chunk
+// starts within a quoted field. this relies on quotes only appearing
+// in quoted fields, where escaped quotes are always paired.
+//
+// returns count+1 boundaries, some chunks may be empty
+template<typename Dialect>
+inline
+std::vector<char const *> split_records(char const *begin, char const *end, unsigned count)
+{
+    assert(count > 0);
+    if (count == 1)
+        return std::vector<char const *>{ begin, end };
 
-    // precedences
-    incl_type_mask &= ~excl_type_mask;
-    if (incl_type_mask & integer_type)   // prefer integer to double and string
-        incl_type_mask &= ~(double_type | string_type);
-    if (incl_type_mask & double_type)    // prefer double to string
-        incl_type_mask &= ~string_type;
+    size_t const chunk_size = (end - begin) / count;
+
+    std::vector<size_t> quotes(count);
+    std::vector<std::thread> threads;
+    for (unsigned loop=0; loop<count; ++loop)
+    {
+        auto const chunk_begin = begin + loop * chunk_size;
+        auto const chunk_end   = (loop == count-1)? end : chunk_begin + chunk_size;
+        threads.emplace_back(
+            [chunk_begin, chunk_end, &quotes, loop]() {
+                quotes[loop] = std::count(chunk_begin, chunk_end, char(Dialect::quote));
+            });
+    }
+    for (auto &thread : threads)
+        thread.join();
 
-    assert(detail::bit_count(incl_type_mask) == 1);
-    auto result = std::make_pair(string_view(begin, it), incl_type_mask);
+    std::vector<char const *> boundaries;
+    boundaries.reserve(count+1);
+    boundaries.push_back(begin);
 
-    // update returning 'begin' iterator to the start next field
-    begin = it;
-    if (in_quotes)
+    size_t quotes_before = 0;
+    for (unsigned loop=1; loop<count; ++loop)
     {
-        if (*begin != '\"')
-            DebugBreak();
-        assert(*begin == '\"');
-        ++begin;
+        quotes_before += quotes[loop-1];
+        auto const nominal  = begin + loop * chunk_size;
+        auto const boundary = find_record_start<Dialect>(nominal, end, (quotes_before % 2) == 1);
+
+        // a long record can span a whole chunk
+        boundaries.push_back(std::max(boundary, boundaries.back()));
     }
-    return result;
+    boundaries.push_back(end);
+    return boundaries;
 }
 
 }   // namespace detail
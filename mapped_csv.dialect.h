@@ -0,0 +1,44 @@
+// Copyright (c) 2013 Craig Henderson
+// Part of the Data Processing Library
+// https://github.com/cdmh/dataproc
+
+#pragma once
+
+namespace cdmh {
+namespace data_processing {
+
+// the delimiter and quote characters of a delimited text format. a
+// dialect is a template parameter of the parser, so each dialect is
+// compiled to a parser with the characters as constants
+template<char Delimiter, char Quote='\"'>
+struct dialect
+{
+    static char const delimiter = Delimiter;
+    static char const quote     = Quote;
+
+    // spaces and tabs around fields are ignored, unless tab is the delimiter
+    static bool const is_padding(char const ch)
+    {
+        return ch == ' '  ||  (ch == '\t'  &&  delimiter != '\t');
+    }
+};
+
+typedef dialect<','>  csv_dialect;      // comma separated values
+typedef dialect<'\t'> tsv_dialect;      // tab separated values
+typedef dialect<'|'>  psv_dialect;      // pipe separated values
+
+namespace detail {
+
+// skip padding and line ends between records
+template<typename Dialect>
+inline
+char const *skip_blank(char const *&it, char const *end)
+{
+    while (it != end  &&  (*it == '\r'  ||  *it == '\n'  ||  Dialect::is_padding(*it)))
+        ++it;
+    return it;
+}
+
+}   // namespace detail
+}   // namespace data_processing
+}   // namespace cdmh
@@ -2,5 +2,8 @@
 // Part of the Data Processing Library
 // https://github.com/cdmh/dataproc
 
+#include "mapped_csv.dialect.h"
+#include "mapped_csv.structural.h"
+#include "number_parsing.h"
 #include "mapped_csv.detail.h"
 
@@ -0,0 +1,245 @@
+// Copyright (c) 2013 Craig Henderson
+// Part of the Data Processing Library
+// https://github.com/cdmh/dataproc
+
+// Structural character scanning for delimited records. Blocks of 64 bytes
+// are classified at once to produce bit masks of the positions of
+// delimiters, line ends and quotes. Field boundaries are then found with
+// bit scans of the cached masks instead of testing each character in turn.
+//
+// AVX2 or SSE2 is used if the compiler targets it, otherwise a portable
+// scalar implementation builds the same masks.
+
+#pragma once
+
+#if defined(__AVX2__)
+#   define DATA_PROCESSING_AVX2
+#endif
+
+#if defined(__SSE2__)  ||  defined(_M_X64)  ||  (defined(_M_IX86_FP)  &&  _M_IX86_FP >= 2)
+#   define DATA_PROCESSING_SSE2
+#endif
+
+#if defined(DATA_PROCESSING_AVX2)  ||  defined(DATA_PROCESSING_SSE2)
+#   include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#   include <intrin.h>
+#endif
+
+namespace cdmh {
+namespace data_processing {
+namespace detail {
+
+// returns the index of the least significant set bit, n must be non-zero
+inline unsigned const count_trailing_zeros(std::uint64_t n)
+{
+    assert(n != 0);
+#if defined(_MSC_VER)  &&  defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, n);
+    return index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, (unsigned long)n))
+        return index;
+    _BitScanForward(&index, (unsigned long)(n >> 32));
+    return index + 32;
+#else
+    return __builtin_ctzll(n);
+#endif
+}
+
+// returns the index of the most significant set bit, n must be non-zero
+inline unsigned const floor_log2(std::uint64_t n)
+{
+    assert(n != 0);
+#if defined(_MSC_VER)  &&  defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, n);
+    return index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanReverse(&index, (unsigned long)(n >> 32)))
+        return index + 32;
+    _BitScanReverse(&index, (unsigned long)n);
+    return index;
+#else
+    return 63 - __builtin_clzll(n);
+#endif
+}
+
+// returns the number of set bits
+inline unsigned const popcount(std::uint64_t n)
+{
+#if defined(_MSC_VER)  &&  defined(_M_X64)
+    return (unsigned)__popcnt64(n);
+#elif defined(_MSC_VER)
+    return __popcnt((unsigned)n) + __popcnt((unsigned)(n >> 32));
+#else
+    return __builtin_popcountll(n);
+#endif
+}
+
+template<typename Dialect>
+class basic_structural_scanner
+{
+  public:
+    static size_t const block_size = 64;
+
+    explicit basic_structural_scanner(char const *end);
+
+    // returns the first delimiter, CR or LF at or after 'it', or end
+    char const *find_field_end(char const *it);
+
+    // returns the first quote at or after 'it', or end
+    char const *find_quote(char const *it);
+
+    // returns the first CR, LF or quote at or after 'it', or end
+    char const *find_line_end_or_quote(char const *it);
+
+  private:
+    void classify_block(char const *it);
+
+    template<std::uint64_t basic_structural_scanner::*Mask>
+    char const *find(char const *it);
+
+  private:
+    char const    *end_;
+    char const    *block_;
+    char const    *block_end_;
+    std::uint64_t  field_end_mask_;
+    std::uint64_t  quote_mask_;
+    std::uint64_t  line_end_or_quote_mask_;
+};
+
+template<typename Dialect>
+inline basic_structural_scanner<Dialect>::basic_structural_scanner(char const *end)
+  : end_(end),
+    block_(nullptr),
+    block_end_(nullptr),
+    field_end_mask_(0),
+    quote_mask_(0),
+    line_end_or_quote_mask_(0)
+{
+}
+
+template<typename Dialect>
+inline char const *basic_structural_scanner<Dialect>::find_field_end(char const *it)
+{
+    return find<&basic_structural_scanner::field_end_mask_>(it);
+}
+
+template<typename Dialect>
+inline char const *basic_structural_scanner<Dialect>::find_quote(char const *it)
+{
+    return find<&basic_structural_scanner::quote_mask_>(it);
+}
+
+template<typename Dialect>
+inline char const *basic_structural_scanner<Dialect>::find_line_end_or_quote(char const *it)
+{
+    return find<&basic_structural_scanner::line_end_or_quote_mask_>(it);
+}
+
+template<typename Dialect>
+template<std::uint64_t basic_structural_scanner<Dialect>::*Mask>
+inline char const *basic_structural_scanner<Dialect>::find(char const *it)
+{
+    while (it < end_)
+    {
+        if (it < block_  ||  it >= block_end_)
+            classify_block(it);
+
+        auto const bits = (this->*Mask) >> (it - block_);
+        if (bits)
+            return it + count_trailing_zeros(bits);
+        it = block_end_;
+    }
+    return end_;
+}
+
+template<typename Dialect>
+inline void basic_structural_scanner<Dialect>::classify_block(char const *it)
+{
+    // the final partial block is copied to a zero padded buffer so
+    // that the same classification is used for all blocks
+    char padded[block_size];
+    char const *block = it;
+    if (size_t(end_ - it) < block_size)
+    {
+        memset(padded, 0, block_size);
+        memcpy(padded, it, end_ - it);
+        block = padded;
+    }
+
+#if defined(DATA_PROCESSING_AVX2)
+    __m256i const delim = _mm256_set1_epi8(Dialect::delimiter);
+    __m256i const cr    = _mm256_set1_epi8('\r');
+    __m256i const lf    = _mm256_set1_epi8('\n');
+    __m256i const quote = _mm256_set1_epi8(Dialect::quote);
+
+    field_end_mask_         = 0;
+    quote_mask_             = 0;
+    line_end_or_quote_mask_ = 0;
+    for (unsigned offset=0; offset<block_size; offset+=32)
+    {
+        __m256i const chars  = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(block + offset));
+        __m256i const eol    = _mm256_or_si256(_mm256_cmpeq_epi8(chars, cr), _mm256_cmpeq_epi8(chars, lf));
+        __m256i const quotes = _mm256_cmpeq_epi8(chars, quote);
+        __m256i const ends   = _mm256_or_si256(_mm256_cmpeq_epi8(chars, delim), eol);
+        field_end_mask_         |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(ends))) << offset;
+        quote_mask_             |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(quotes))) << offset;
+        line_end_or_quote_mask_ |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(_mm256_or_si256(eol, quotes)))) << offset;
+    }
+#elif defined(DATA_PROCESSING_SSE2)
+    __m128i const delim = _mm_set1_epi8(Dialect::delimiter);
+    __m128i const cr    = _mm_set1_epi8('\r');
+    __m128i const lf    = _mm_set1_epi8('\n');
+    __m128i const quote = _mm_set1_epi8(Dialect::quote);
+
+    field_end_mask_         = 0;
+    quote_mask_             = 0;
+    line_end_or_quote_mask_ = 0;
+    for (unsigned offset=0; offset<block_size; offset+=16)
+    {
+        __m128i const chars  = _mm_loadu_si128(reinterpret_cast<__m128i const *>(block + offset));
+        __m128i const eol    = _mm_or_si128(_mm_cmpeq_epi8(chars, cr), _mm_cmpeq_epi8(chars, lf));
+        __m128i const quotes = _mm_cmpeq_epi8(chars, quote);
+        __m128i const ends   = _mm_or_si128(_mm_cmpeq_epi8(chars, delim), eol);
+        field_end_mask_         |= std::uint64_t(_mm_movemask_epi8(ends)) << offset;
+        quote_mask_             |= std::uint64_t(_mm_movemask_epi8(quotes)) << offset;
+        line_end_or_quote_mask_ |= std::uint64_t(_mm_movemask_epi8(_mm_or_si128(eol, quotes))) << offset;
+    }
+#else
+    field_end_mask_         = 0;
+    quote_mask_             = 0;
+    line_end_or_quote_mask_ = 0;
+    for (unsigned offset=0; offset<block_size; ++offset)
+    {
+        char const ch = block[offset];
+        if (ch == Dialect::delimiter)
+            field_end_mask_ |= std::uint64_t(1) << offset;
+        else if (ch == '\r'  ||  ch == '\n')
+        {
+            field_end_mask_         |= std::uint64_t(1) << offset;
+            line_end_or_quote_mask_ |= std::uint64_t(1) << offset;
+        }
+        else if (ch == Dialect::quote)
+        {
+            quote_mask_             |= std::uint64_t(1) << offset;
+            line_end_or_quote_mask_ |= std::uint64_t(1) << offset;
+        }
+    }
+#endif
+
+    block_     = it;
+    block_end_ = (size_t(end_ - it) < block_size)? end_ : it + block_size;
+}
+
+typedef basic_structural_scanner<csv_dialect> structural_scanner;
+
+}   // namespace detail
+}   // namespace data_processing
+}   // namespace cdmh
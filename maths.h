@@ -52,6 +52,58 @@ inline T const mode(std::vector<T> &&data)
     return element->first;
 }
 
+// the median of data that is sorted in ascending order
+template<typename T>
+inline T const sorted_median(std::vector<T> const &data)
+{
+    if (data.size() == 0)
+        throw math_error("No data");
+    return data[data.size() / 2];
+}
+
+// the mode of data that is sorted in ascending order. equal values are
+// adjacent, so the mode is the value of the longest run, and the least
+// value is returned if several runs are as long
+template<typename T>
+inline T const sorted_mode(std::vector<T> const &data)
+{
+    if (data.size() == 0)
+        throw math_error("No data");
+
+    size_t mode = 0;
+    size_t longest = 0;
+    for (size_t start=0, end; start<data.size(); start=end)
+    {
+        for (end=start+1; end<data.size()  &&  data[end] == data[start]; ++end)
+            ;
+        if (end - start > longest)
+        {
+            mode    = start;
+            longest = end - start;
+        }
+    }
+
+    if (longest == 1)
+        throw math_error("No mode value exists");
+    return data[mode];
+}
+
+// the standard deviation of data, without copying the data
+template<typename T>
+inline double const standard_deviation(std::vector<T> const &data)
+{
+    if (data.size() == 0)
+        throw math_error("No data");
+
+    double const mean = (double)std::accumulate(data.cbegin(), data.cend(), T()) / data.size();
+
+    double sum_squared_differences = 0.0;
+    for (auto const &value : data)
+        sum_squared_differences += (mean - value) * (mean - value);
+
+    return sqrt(sum_squared_differences / data.size());
+}
+
 template<typename T>
 inline double const standard_deviation(std::vector<T> &&data)
 {
@@ -0,0 +1,89 @@
+// Copyright (c) 2013 Craig Henderson
+// Part of the Data Processing Library
+// https://github.com/cdmh/dataproc
+
+#pragma once
+
+#include <thread>
+
+namespace cdmh {
+namespace data_processing {
+
+template<typename Dialect>
+inline basic_record_index<Dialect>::basic_record_index(char const *begin, char const *end, unsigned thread_count)
+  : header_(detail::skip_blank<Dialect>(begin, end)),
+    end_(end)
+{
+    // a minimum chunk size stops small buffers being split needlessly
+    size_t const min_chunk_size = 64 * 1024;
+
+    if (thread_count == 0)
+        thread_count = std::max(1U, std::thread::hardware_concurrency());
+
+    detail::basic_structural_scanner<Dialect> scanner(end);
+    begin = detail::find_record_end(scanner, header_, end);
+    if (detail::skip_blank<Dialect>(begin, end) == end)
+        return;
+
+    // each chunk is indexed by a thread, and the chunk indexes are
+    // then joined in order
+    unsigned const chunk_count = (unsigned)std::min<size_t>(thread_count, (end - begin) / min_chunk_size + 1);
+    auto const boundaries = detail::split_records<Dialect>(begin, end, chunk_count);
+
+    std::vector<std::vector<char const *>> chunks(chunk_count);
+    std::vector<std::thread> threads;
+    for (unsigned loop=0; loop<chunk_count; ++loop)
+    {
+        threads.emplace_back(
+            [&chunks, &boundaries, loop]() {
+                auto       it        = boundaries[loop];
+                auto const chunk_end = boundaries[loop+1];
+                detail::basic_structural_scanner<Dialect> scanner(chunk_end);
+                while (detail::skip_blank<Dialect>(it, chunk_end) != chunk_end)
+                {
+                    chunks[loop].push_back(it);
+                    it = detail::find_record_end(scanner, it, chunk_end);
+                }
+            });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    size_t size = 0;
+    for (auto const &chunk : chunks)
+        size += chunk.size();
+    records_.reserve(size);
+    for (auto const &chunk : chunks)
+        records_.insert(records_.end(), chunk.begin(), chunk.end());
+}
+
+// returns the start of a record, or the end of the buffer if n is the
+// number of records
+template<typename Dialect>
+inline char const *basic_record_index<Dialect>::record(size_t n) const
+{
+    assert(n <= records_.size());
+    return (n == records_.size())? end_ : records_[n];
+}
+
+// attach the rows [first_row, last_row) of an indexed buffer. only the
+// header and the records in the range are read
+template<typename Dialect>
+inline bool const dataset::attach_rows(basic_record_index<Dialect> const &index, size_t first_row, size_t last_row)
+{
+    if (first_row > last_row  ||  last_row > index.size())
+        throw std::out_of_range("Invalid row range");
+
+    auto it = index.header();
+    detail::basic_structural_scanner<Dialect> header_scanner(index.end());
+    attach_header(header_scanner, it, index.end());
+
+    it = index.record(first_row);
+    auto const end = index.record(last_row);
+    detail::basic_structural_scanner<Dialect> scanner(end);
+    attach_records(scanner, it, end, 0);
+    return true;
+}
+
+}   // namespace data_processing
+}   // namespace cdmh
@@ -0,0 +1,545 @@
+// Copyright (c) 2013 Craig Henderson
+// Part of the Data Processing Library
+// https://github.com/cdmh/dataproc
+
+// Reductions of the native values of a column: the sum, the sum of
+// squares, and the min and max of the values that aren't null. AVX-512
+// and AVX2 kernels are selected at run time by the instruction sets that
+// the processor supports, with scalar kernels for other processors. The
+// vector kernels are compiled for their instruction set whatever the
+// compiler targets, so a library built for any x64 processor uses the
+// widest kernels that it can.
+//
+// Doubles are summed into 16 partial sums. Each kernel adds a value to
+// the same partial sum, and the partial sums are added in the same order,
+// so every kernel returns the same sum. A square is rounded before it is
+// added, as it is without FMA, so that a kernel that is compiled for an
+// instruction set with FMA doesn't fuse the multiply and the add.
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+#if defined(_M_X64)  ||  defined(__x86_64__)
+#   define DATA_PROCESSING_SIMD_DISPATCH
+#   if !defined(_MSC_VER)  ||  _MSC_VER >= 1911
+#       define DATA_PROCESSING_AVX512_KERNELS
+#   endif
+#endif
+
+#if defined(DATA_PROCESSING_SIMD_DISPATCH)
+#   include <immintrin.h>
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#       define DATA_PROCESSING_TARGET(isa)
+#   else
+#       include <cpuid.h>
+#       define DATA_PROCESSING_TARGET(isa) __attribute__((target(isa)))
+#   endif
+#endif
+
+// an empty asm statement that the value passes through, which a
+// compiler can't fuse with the operations around it. the value is kept
+// in a vector register on x86-64, and passes through memory elsewhere,
+// as other targets have no "v" constraint. MSVC doesn't fuse the
+// operations of intrinsics, or of scalar code unless it is allowed
+#if defined(__GNUC__)  &&  defined(DATA_PROCESSING_SIMD_DISPATCH)
+#   define DATA_PROCESSING_ROUNDED(value) __asm__("" : "+v"(value))
+#elif defined(__GNUC__)
+#   define DATA_PROCESSING_ROUNDED(value) __asm__("" : "+m"(value))
+#else
+#   define DATA_PROCESSING_ROUNDED(value)
+#endif
+
+namespace cdmh {
+namespace data_processing {
+namespace detail {
+
+// the kernels that are used, in order of preference
+enum simd_level { scalar_kernels, avx2_kernels, avx512_kernels };
+
+// returns the widest kernels that the processor and operating system
+// support. AVX-512 kernels need AVX-512F and AVX-512DQ
+inline simd_level const detect_simd_level()
+{
+#if defined(DATA_PROCESSING_SIMD_DISPATCH)
+    unsigned registers[4] = { 0 };      // eax, ebx, ecx, edx
+    auto const cpuid = [&registers](unsigned leaf) {
+#if defined(_MSC_VER)
+        __cpuidex(reinterpret_cast<int *>(registers), leaf, 0);
+#else
+        __cpuid_count(leaf, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+    };
+
+    cpuid(0);
+    if (registers[0] < 7)
+        return scalar_kernels;
+
+    // the operating system must save the vector registers
+    cpuid(1);
+    if ((registers[2] & (1 << 27)) == 0  ||  (registers[2] & (1 << 28)) == 0)
+        return scalar_kernels;
+#if defined(_MSC_VER)
+    std::uint64_t const xcr0 = _xgetbv(0);
+#else
+    unsigned xcr0_low, xcr0_high;
+    __asm__("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+    std::uint64_t const xcr0 = (std::uint64_t(xcr0_high) << 32) | xcr0_low;
+#endif
+    if ((xcr0 & 0x6) != 0x6)
+        return scalar_kernels;
+
+    cpuid(7);
+    bool const avx2   = (registers[1] & (1 << 5)) != 0;
+    bool const avx512 = (registers[1] & (1 << 16)) != 0  &&  (registers[1] & (1 << 17)) != 0  &&  (xcr0 & 0xe6) == 0xe6;
+#if defined(DATA_PROCESSING_AVX512_KERNELS)
+    if (avx2  &&  avx512)
+        return avx512_kernels;
+#else
+    (void)avx512;
+#endif
+    if (avx2)
+        return avx2_kernels;
+#endif
+    return scalar_kernels;
+}
+
+inline simd_level const supported_simd_level()
+{
+    static simd_level const level = detect_simd_level();
+    return level;
+}
+
+// returns the square of a value, rounded to a double
+inline double const square(double value)
+{
+    double product = value * value;
+    DATA_PROCESSING_ROUNDED(product);
+    return product;
+}
+
+// add the 16 partial sums of doubles pairwise
+inline double const add_partial_sums(double *partial)
+{
+    for (size_t width=8; width != 0; width /= 2)
+    {
+        for (size_t lane=0; lane<width; ++lane)
+            partial[lane] += partial[lane + width];
+    }
+    return partial[0];
+}
+
+/*
+    scalar kernels
+*/
+inline std::int64_t const sum_scalar(std::int64_t const *values, size_t count)
+{
+    // unsigned arithmetic wraps on overflow, as the vector kernels do
+    std::uint64_t sum = 0;
+    for (size_t index=0; index<count; ++index)
+        sum += std::uint64_t(values[index]);
+    return std::int64_t(sum);
+}
+
+inline double const sum_scalar(double const *values, size_t count)
+{
+    double partial[16] = { 0 };
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16)
+    {
+        for (size_t lane=0; lane<16; ++lane)
+            partial[lane] += values[index + lane];
+    }
+    for (size_t lane=0; index<count  &&  lane<16; ++index, ++lane)
+        partial[lane] += values[index];
+    return add_partial_sums(partial);
+}
+
+template<typename T>
+inline double const sum_of_squares_scalar(T const *values, size_t count)
+{
+    double partial[16] = { 0 };
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16)
+    {
+        for (size_t lane=0; lane<16; ++lane)
+            partial[lane] += square(double(values[index + lane]));
+    }
+    for (size_t lane=0; index<count  &&  lane<16; ++index, ++lane)
+        partial[lane] += square(double(values[index]));
+    return add_partial_sums(partial);
+}
+
+template<typename T>
+inline void min_max_scalar(T const *values, std::uint64_t const *valid, size_t words, T &min, T &max)
+{
+    for (size_t word=0; word<words; ++word)
+    {
+        for (auto bits=valid[word]; bits != 0; bits &= bits - 1)
+        {
+            T const value = values[word * 64 + count_trailing_zeros(bits)];
+            min = std::min(min, value);
+            max = std::max(max, value);
+        }
+    }
+}
+
+#if defined(DATA_PROCESSING_SIMD_DISPATCH)
+/*
+    AVX2 kernels
+*/
+DATA_PROCESSING_TARGET("avx2")
+inline std::int64_t const sum_avx2(std::int64_t const *values, size_t count)
+{
+    __m256i sum0 = _mm256_setzero_si256();
+    __m256i sum1 = _mm256_setzero_si256();
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8)
+    {
+        sum0 = _mm256_add_epi64(sum0, _mm256_loadu_si256(reinterpret_cast<__m256i const *>(values + index)));
+        sum1 = _mm256_add_epi64(sum1, _mm256_loadu_si256(reinterpret_cast<__m256i const *>(values + index + 4)));
+    }
+
+    std::uint64_t partial[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(partial), _mm256_add_epi64(sum0, sum1));
+    std::uint64_t sum = partial[0] + partial[1] + partial[2] + partial[3];
+    for (; index<count; ++index)
+        sum += std::uint64_t(values[index]);
+    return std::int64_t(sum);
+}
+
+DATA_PROCESSING_TARGET("avx2")
+inline double const sum_avx2(double const *values, size_t count)
+{
+    __m256d sum0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd();
+    __m256d sum2 = _mm256_setzero_pd();
+    __m256d sum3 = _mm256_setzero_pd();
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16)
+    {
+        sum0 = _mm256_add_pd(sum0, _mm256_loadu_pd(values + index));
+        sum1 = _mm256_add_pd(sum1, _mm256_loadu_pd(values + index + 4));
+        sum2 = _mm256_add_pd(sum2, _mm256_loadu_pd(values + index + 8));
+        sum3 = _mm256_add_pd(sum3, _mm256_loadu_pd(values + index + 12));
+    }
+
+    double partial[16];
+    _mm256_storeu_pd(partial,      sum0);
+    _mm256_storeu_pd(partial + 4,  sum1);
+    _mm256_storeu_pd(partial + 8,  sum2);
+    _mm256_storeu_pd(partial + 12, sum3);
+    for (size_t lane=0; index<count  &&  lane<16; ++index, ++lane)
+        partial[lane] += values[index];
+    return add_partial_sums(partial);
+}
+
+// the squares of four values, which are converted to doubles one at a
+// time as AVX2 has no conversion of 64 bit integers
+DATA_PROCESSING_TARGET("avx2")
+inline __m256d const squares_avx2(std::int64_t const *values)
+{
+    __m256d const value   = _mm256_set_pd(double(values[3]), double(values[2]), double(values[1]), double(values[0]));
+    __m256d       squares = _mm256_mul_pd(value, value);
+    DATA_PROCESSING_ROUNDED(squares);
+    return squares;
+}
+
+DATA_PROCESSING_TARGET("avx2")
+inline __m256d const squares_avx2(double const *values)
+{
+    __m256d const value   = _mm256_loadu_pd(values);
+    __m256d       squares = _mm256_mul_pd(value, value);
+    DATA_PROCESSING_ROUNDED(squares);
+    return squares;
+}
+
+template<typename T>
+DATA_PROCESSING_TARGET("avx2")
+inline double const sum_of_squares_avx2(T const *values, size_t count)
+{
+    __m256d sum0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd();
+    __m256d sum2 = _mm256_setzero_pd();
+    __m256d sum3 = _mm256_setzero_pd();
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16)
+    {
+        sum0 = _mm256_add_pd(sum0, squares_avx2(values + index));
+        sum1 = _mm256_add_pd(sum1, squares_avx2(values + index + 4));
+        sum2 = _mm256_add_pd(sum2, squares_avx2(values + index + 8));
+        sum3 = _mm256_add_pd(sum3, squares_avx2(values + index + 12));
+    }
+
+    double partial[16];
+    _mm256_storeu_pd(partial,      sum0);
+    _mm256_storeu_pd(partial + 4,  sum1);
+    _mm256_storeu_pd(partial + 8,  sum2);
+    _mm256_storeu_pd(partial + 12, sum3);
+    for (size_t lane=0; index<count  &&  lane<16; ++index, ++lane)
+        partial[lane] += square(double(values[index]));
+    return add_partial_sums(partial);
+}
+
+// a mask of the four lanes that have a bit set in the low four bits
+DATA_PROCESSING_TARGET("avx2")
+inline __m256i const lane_mask_avx2(std::uint64_t bits)
+{
+    __m256i const lanes = _mm256_setr_epi64x(1, 2, 4, 8);
+    return _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(std::int64_t(bits & 15)), lanes), lanes);
+}
+
+// the rows of each word of the null bitmap but the last are read as
+// vectors, and the bits of the word mask the rows that are null. the
+// last word may be a partial word, so its rows are read one at a time
+DATA_PROCESSING_TARGET("avx2")
+inline void min_max_avx2(std::int64_t const *values, std::uint64_t const *valid, size_t words, std::int64_t &min, std::int64_t &max)
+{
+    if (words == 0)
+        return;
+
+    __m256i vmin = _mm256_set1_epi64x(min);
+    __m256i vmax = _mm256_set1_epi64x(max);
+    for (size_t word=0; word<words-1; ++word)
+    {
+        auto const block = values + word * 64;
+        for (size_t index=0, bits=valid[word]; bits != 0; index += 4, bits >>= 4)
+        {
+            __m256i const mask  = lane_mask_avx2(bits);
+            __m256i const value = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(block + index));
+            vmin = _mm256_blendv_epi8(vmin, value, _mm256_and_si256(mask, _mm256_cmpgt_epi64(vmin, value)));
+            vmax = _mm256_blendv_epi8(vmax, value, _mm256_and_si256(mask, _mm256_cmpgt_epi64(value, vmax)));
+        }
+    }
+    min_max_scalar(values + (words - 1) * 64, valid + words - 1, 1, min, max);
+
+    std::int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), vmin);
+    min = std::min(min, *std::min_element(lanes, lanes + 4));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), vmax);
+    max = std::max(max, *std::max_element(lanes, lanes + 4));
+}
+
+DATA_PROCESSING_TARGET("avx2")
+inline void min_max_avx2(double const *values, std::uint64_t const *valid, size_t words, double &min, double &max)
+{
+    if (words == 0)
+        return;
+
+    __m256d vmin = _mm256_set1_pd(min);
+    __m256d vmax = _mm256_set1_pd(max);
+    for (size_t word=0; word<words-1; ++word)
+    {
+        auto const block = values + word * 64;
+        for (size_t index=0, bits=valid[word]; bits != 0; index += 4, bits >>= 4)
+        {
+            __m256d const mask  = _mm256_castsi256_pd(lane_mask_avx2(bits));
+            __m256d const value = _mm256_loadu_pd(block + index);
+            vmin = _mm256_blendv_pd(vmin, _mm256_min_pd(vmin, value), mask);
+            vmax = _mm256_blendv_pd(vmax, _mm256_max_pd(vmax, value), mask);
+        }
+    }
+    min_max_scalar(values + (words - 1) * 64, valid + words - 1, 1, min, max);
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, vmin);
+    min = std::min(min, *std::min_element(lanes, lanes + 4));
+    _mm256_storeu_pd(lanes, vmax);
+    max = std::max(max, *std::max_element(lanes, lanes + 4));
+}
+#endif
+
+#if defined(DATA_PROCESSING_AVX512_KERNELS)
+/*
+    AVX-512 kernels
+*/
+DATA_PROCESSING_TARGET("avx512f,avx512dq")
+inline std::int64_t const sum_avx512(std::int64_t const *values, size_t count)
+{
+    __m512i sum0 = _mm512_setzero_si512();
+    __m512i sum1 = _mm512_setzero_si512();
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16)
+    {
+        sum0 = _mm512_add_epi64(sum0, _mm512_loadu_si512(values + index));
+        sum1 = _mm512_add_epi64(sum1, _mm512_loadu_si512(values + index + 8));
+    }
+
+    std::uint64_t partial[8];
+    _mm512_storeu_si512(partial, _mm512_add_epi64(sum0, sum1));
+    std::uint64_t sum = 0;
+    for (size_t lane=0; lane<8; ++lane)
+        sum += partial[lane];
+    for (; index<count; ++index)
+        sum += std::uint64_t(values[index]);
+    return std::int64_t(sum);
+}
+
+DATA_PROCESSING_TARGET("avx512f,avx512dq")
+inline double const sum_avx512(double const *values, size_t count)
+{
+    __m512d sum0 = _mm512_setzero_pd();
+    __m512d sum1 = _mm512_setzero_pd();
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16)
+    {
+        sum0 = _mm512_add_pd(sum0, _mm512_loadu_pd(values + index));
+        sum1 = _mm512_add_pd(sum1, _mm512_loadu_pd(values + index + 8));
+    }
+
+    double partial[16];
+    _mm512_storeu_pd(partial,     sum0);
+    _mm512_storeu_pd(partial + 8, sum1);
+    for (size_t lane=0; index<count  &&  lane<16; ++index, ++lane)
+        partial[lane] += values[index];
+    return add_partial_sums(partial);
+}
+
+DATA_PROCESSING_TARGET("avx512f,avx512dq")
+inline __m512d const squares_avx512(std::int64_t const *values)
+{
+    __m512d const value   = _mm512_cvtepi64_pd(_mm512_loadu_si512(values));
+    __m512d       squares = _mm512_mul_pd(value, value);
+    DATA_PROCESSING_ROUNDED(squares);
+    return squares;
+}
+
+DATA_PROCESSING_TARGET("avx512f,avx512dq")
+inline __m512d const squares_avx512(double const *values)
+{
+    __m512d const value   = _mm512_loadu_pd(values);
+    __m512d       squares = _mm512_mul_pd(value, value);
+    DATA_PROCESSING_ROUNDED(squares);
+    return squares;
+}
+
+template<typename T>
+DATA_PROCESSING_TARGET("avx512f,avx512dq")
+inline double const sum_of_squares_avx512(T const *values, size_t count)
+{
+    __m512d sum0 = _mm512_setzero_pd();
+    __m512d sum1 = _mm512_setzero_pd();
+    size_t index = 0;
+    for (; index + 16 <= count; index += 16)
+    {
+        sum0 = _mm512_add_pd(sum0, squares_avx512(values + index));
+        sum1 = _mm512_add_pd(sum1, squares_avx512(values + index + 8));
+    }
+
+    double partial[16];
+    _mm512_storeu_pd(partial,     sum0);
+    _mm512_storeu_pd(partial + 8, sum1);
+    for (size_t lane=0; index<count  &&  lane<16; ++index, ++lane)
+        partial[lane] += square(double(values[index]));
+    return add_partial_sums(partial);
+}
+
+// the null bitmap is used as the mask of the loads and comparisons, a
+// byte for each vector of eight values
+DATA_PROCESSING_TARGET("avx512f,avx512dq")
+inline void min_max_avx512(std::int64_t const *values, std::uint64_t const *valid, size_t words, std::int64_t &min, std::int64_t &max)
+{
+    __m512i vmin = _mm512_set1_epi64(min);
+    __m512i vmax = _mm512_set1_epi64(max);
+    for (size_t word=0; word<words; ++word)
+    {
+        for (size_t index=0, bits=valid[word]; bits != 0; index += 8, bits >>= 8)
+        {
+            __mmask8 const mask  = __mmask8(bits);
+            __m512i  const value = _mm512_maskz_loadu_epi64(mask, values + word * 64 + index);
+            vmin = _mm512_mask_min_epi64(vmin, mask, vmin, value);
+            vmax = _mm512_mask_max_epi64(vmax, mask, vmax, value);
+        }
+    }
+    std::int64_t lanes[8];
+    _mm512_storeu_si512(lanes, vmin);
+    min = *std::min_element(lanes, lanes + 8);
+    _mm512_storeu_si512(lanes, vmax);
+    max = *std::max_element(lanes, lanes + 8);
+}
+
+DATA_PROCESSING_TARGET("avx512f,avx512dq")
+inline void min_max_avx512(double const *values, std::uint64_t const *valid, size_t words, double &min, double &max)
+{
+    __m512d vmin = _mm512_set1_pd(min);
+    __m512d vmax = _mm512_set1_pd(max);
+    for (size_t word=0; word<words; ++word)
+    {
+        for (size_t index=0, bits=valid[word]; bits != 0; index += 8, bits >>= 8)
+        {
+            __mmask8 const mask  = __mmask8(bits);
+            __m512d  const value = _mm512_maskz_loadu_pd(mask, values + word * 64 + index);
+            vmin = _mm512_mask_min_pd(vmin, mask, vmin, value);
+            vmax = _mm512_mask_max_pd(vmax, mask, vmax, value);
+        }
+    }
+    double lanes[8];
+    _mm512_storeu_pd(lanes, vmin);
+    min = *std::min_element(lanes, lanes + 8);
+    _mm512_storeu_pd(lanes, vmax);
+    max = *std::max_element(lanes, lanes + 8);
+}
+#endif
+
+/*
+    dispatch to the widest kernels that the processor supports, or to
+    narrower kernels if a level is given
+*/
+
+// returns the sum of the values, wrapping on overflow
+template<typename T>
+inline T const reduce_sum(T const *values, size_t count, simd_level level=supported_simd_level())
+{
+    switch (std::min(level, supported_simd_level()))
+    {
+#if defined(DATA_PROCESSING_AVX512_KERNELS)
+        case avx512_kernels:    return sum_avx512(values, count);
+#endif
+#if defined(DATA_PROCESSING_SIMD_DISPATCH)
+        case avx2_kernels:      return sum_avx2(values, count);
+#endif
+        default:                return sum_scalar(values, count);
+    }
+}
+
+// returns the sum of the squares of the values
+template<typename T>
+inline double const reduce_sum_of_squares(T const *values, size_t count, simd_level level=supported_simd_level())
+{
+    switch (std::min(level, supported_simd_level()))
+    {
+#if defined(DATA_PROCESSING_AVX512_KERNELS)
+        case avx512_kernels:    return sum_of_squares_avx512(values, count);
+#endif
+#if defined(DATA_PROCESSING_SIMD_DISPATCH)
+        case avx2_kernels:      return sum_of_squares_avx2(values, count);
+#endif
+        default:                return sum_of_squares_scalar(values, count);
+    }
+}
+
+// find the min and max of the values that have a bit set in a null
+// bitmap of 'words' 64 bit words. returns false if no bits are set
+template<typename T>
+inline bool const reduce_min_max(T const *values, std::uint64_t const *valid, size_t words, T &min, T &max, simd_level level=supported_simd_level())
+{
+    min = std::numeric_limits<T>::max();
+    max = std::numeric_limits<T>::lowest();
+    switch (std::min(level, supported_simd_level()))
+    {
+#if defined(DATA_PROCESSING_AVX512_KERNELS)
+        case avx512_kernels:    min_max_avx512(values, valid, words, min, max);     break;
+#endif
+#if defined(DATA_PROCESSING_SIMD_DISPATCH)
+        case avx2_kernels:      min_max_avx2(values, valid, words, min, max);       break;
+#endif
+        default:                min_max_scalar(values, valid, words, min, max);     break;
+    }
+    return min <= max;
+}
+
+}   // namespace detail
+}   // namespace data_processing
+}   // namespace cdmh
@@ -0,0 +1,34 @@
+// Copyright (c) 2013 Craig Henderson
+// Part of the Data Processing Library
+// https://github.com/cdmh/dataproc
+
+#pragma once
+
+namespace cdmh {
+namespace data_processing {
+
+template<typename Dialect>
+inline basic_row_group_reader<Dialect>::basic_row_group_reader(char const *begin, char const *end, size_t rows_per_group)
+  : scanner_(end),
+    it_(begin),
+    end_(end),
+    rows_per_group_(rows_per_group),
+    first_row_(0)
+{
+    assert(rows_per_group > 0);
+    group_.attach_header(scanner_, it_, end_);
+}
+
+// read the next group of rows, returns false if there are no more rows.
+// column types are inferred from the values in the group alone
+template<typename Dialect>
+inline bool const basic_row_group_reader<Dialect>::next()
+{
+    first_row_ += group_.rows();
+    group_.erase_rows();
+    group_.attach_records(scanner_, it_, end_, rows_per_group_);
+    return group_.rows() > 0;
+}
+
+}   // namespace data_processing
+}   // namespace cdmh
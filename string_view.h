@@ -132,6 +132,23 @@ bool const operator<(string_view const &first, string_view const &second)
     return strncasecmp(first.begin(), second.begin(), len1) < 0;
 }
 
+// a case insensitive hash of a string_view, consistent with operator==
+struct string_view_hash
+{
+    size_t const operator()(string_view const &string) const
+    {
+        size_t hash = 2166136261U;
+        for (auto it=string.begin(); it!=string.end(); ++it)
+        {
+            int ch = *it;
+            if (ch >= 'A'  &&  ch <= 'Z')
+                ch -= 'A' - 'a';
+            hash = (hash ^ ch) * 16777619U;
+        }
+        return hash;
+    }
+};
+
 template<typename E, typename T>
 inline
 std::basic_ostream<E, T> &operator<<(std::basic_ostream<E, T> &o, string_view const &str)
@@ -0,0 +1,953 @@
+// Copyright (c) 2013 Craig Henderson
+// Part of the Data Processing Library
+// https://github.com/cdmh/dataproc
+
+// Benchmarks are hidden from the default test run. Run them with
+//     data-processing "[benchmark]"
+
+#include "stdafx.h"
+#include <iostream>
+#include <chrono>
+#include <sstream>
+#include "data-processing.h"
+
+#include "catch.hpp"
+
+namespace { // anonymous namespace
+
+using cdmh::data_processing::dataset;
+using cdmh::data_processing::string_view;
+using cdmh::data_processing::type_mask_t;
+
+// generate a CSV buffer with integer, double, quoted text and null columns
+inline
+std::string generate_csv(size_t rows, size_t columns)
+{
+    std::ostringstream csv;
+    for (size_t column=0; column<columns; ++column)
+        csv << (column? "," : "") << "column" << column;
+    csv << "\r\n";
+
+    for (size_t row=0; row<rows; ++row)
+    {
+        for (size_t column=0; column<columns; ++column)
+        {
+            if (column)
+                csv << ',';
+
+            switch ((row + column) % 4)
+            {
+                case 0:  csv << row * 7 + column;                                    break;
+                case 1:  csv << (row % 1000) << '.' << (column % 100);               break;
+                case 2:  csv << "\"text " << row << " with, a comma\"";              break;
+                case 3:  if (row % 3)  csv << "  " << column << "  ";                break;
+            }
+        }
+        csv << "\r\n";
+    }
+    return csv.str();
+}
+
+template<typename Fn>
+inline
+double seconds(Fn fn)
+{
+    auto const start = std::chrono::high_resolution_clock::now();
+    fn();
+    auto const finish = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(finish - start).count();
+}
+
+inline
+void report(char const *name, size_t bytes, double seconds)
+{
+    std::cout << "    " << name << ": "
+              << std::fixed << std::setprecision(1)
+              << (bytes / seconds / (1024.0 * 1024.0)) << " MB/s\n";
+}
+
+namespace original {
+
+// the scalar field reader, testing each character in turn
+inline
+std::pair<string_view, type_mask_t>
+read_field(char const *&begin, char const *end)
+{
+    while (begin != end  &&  (*begin == ' '  ||  *begin == '\t'))
+        ++begin;
+
+    if (begin != end  &&  *begin == '\"')
+    {
+        auto it = ++begin;
+        while (it != end  &&  (*it != '\"'  ||  (it+1 != end  &&  *(it+1) == '\"')))
+            it += (*it == '\"')? 2 : 1;
+
+        auto result = std::make_pair(string_view(begin, it), (begin == it)? null_type : string_type);
+        begin = (it == end)? it : it + 1;
+        return result;
+    }
+
+    auto it = begin;
+    while (it != end  &&  *it != ','  &&  *it != '\r'  &&  *it != '\n')
+        ++it;
+
+    auto field_end = it;
+    cdmh::data_processing::detail::rtrim(begin, field_end);
+    auto result = std::make_pair(string_view(begin, field_end), cdmh::data_processing::detail::field_type(begin, field_end));
+    begin = it;
+    return result;
+}
+
+// the two-pass record reader that dataset::attach used previously. the
+// end of line was found by reading every field, and the record was then
+// read again to store the fields
+inline
+char const *find_eol(char const *it, char const *ite)
+{
+    while (it != ite)
+    {
+        read_field(it, ite);
+        if (it == ite  ||  *it == '\r'  ||  *it == '\n')
+            return it;
+        ++it;
+    }
+    return it;
+}
+
+inline
+size_t attach(char const *begin, char const *end)
+{
+    std::vector<std::vector<dataset::cell_value>> values;
+    std::vector<type_mask_t>                      types;
+    bool header = true;
+    while (cdmh::data_processing::detail::ltrim(begin, end) != end)
+    {
+        auto const eol = find_eol(begin, end);
+        for (unsigned index=0; begin!=eol; ++index)
+        {
+            auto const field = read_field(begin, eol);
+            if (header)
+            {
+                values.push_back(std::vector<dataset::cell_value>());
+                types.push_back(0);
+            }
+            else
+            {
+                if (field.second != null_type)
+                    types[index] = (types[index] == 0  ||  types[index] == field.second)? field.second : string_type;
+                values[index].emplace_back(field.first);
+            }
+
+            if (begin != eol)
+                ++begin;
+        }
+        header = false;
+    }
+    return values.empty()? 0 : values[0].size();
+}
+
+// a store of the fields of each column, for timing the sink that
+// dataset::process_record calls for each field
+class field_store
+{
+  public:
+    void store(unsigned index, string_view const &value, type_mask_t /*type*/)
+    {
+        if (index >= values_.size())
+            values_.resize(index + 1);
+        values_[index].push_back(value);
+    }
+
+    size_t const rows() const
+    {
+        return values_.empty()? 0 : values_[0].size() - 1;
+    }
+
+  private:
+    std::vector<std::vector<string_view>> values_;
+};
+
+// read each record in a single pass, as dataset::attach_records does,
+// passing each field to a sink
+template<typename Fn>
+inline
+void read_records(char const *begin, char const *end, Fn const &fn)
+{
+    cdmh::data_processing::detail::structural_scanner scanner(end);
+    while (cdmh::data_processing::detail::skip_blank<cdmh::data_processing::csv_dialect>(begin, end) != end)
+    {
+        for (unsigned index=0; ; ++index)
+        {
+            auto const field = cdmh::data_processing::detail::read_field(scanner, begin, end);
+            fn(index, field.first, field.second);
+            if (begin == end  ||  *begin != ',')
+                break;
+            ++begin;
+        }
+    }
+}
+
+// the sink that dataset::attach_records used previously, a member
+// function bound into a std::function, so each field is an indirect call
+inline
+size_t attach_bound(char const *begin, char const *end)
+{
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+    using std::placeholders::_3;
+
+    field_store store;
+    std::function<void (unsigned, string_view const &, type_mask_t)> fn = std::bind(&field_store::store, &store, _1, _2, _3);
+    read_records(begin, end, fn);
+    return store.rows();
+}
+
+// the sink that dataset::attach_records uses, a lambda that is inlined
+// into the field loop
+inline
+size_t attach_inlined(char const *begin, char const *end)
+{
+    field_store store;
+    read_records(
+        begin, end,
+        [&store](unsigned index, string_view const &value, type_mask_t type) {
+            store.store(index, value, type);
+        });
+    return store.rows();
+}
+
+}   // namespace original
+
+inline
+void benchmark_attach(std::string const &csv, size_t rows)
+{
+    std::cout << "\nattach " << rows << " rows, " << csv.length() << " bytes\n";
+
+    size_t original_rows = 0;
+    auto const two_pass = seconds([&csv, &original_rows]() {
+        original_rows = original::attach(csv.data(), csv.data() + csv.length());
+    });
+
+    dataset ds;
+    auto const single_pass = seconds([&csv, &ds]() {
+        ds.attach(csv.data(), csv.data() + csv.length());
+    });
+
+    dataset parallel;
+    auto const parallel_pass = seconds([&csv, &parallel]() {
+        parallel.attach_parallel(csv.data(), csv.data() + csv.length());
+    });
+
+    report("two pass, scalar    ", csv.length(), two_pass);
+    report("single pass, blocked", csv.length(), single_pass);
+    report("parallel            ", csv.length(), parallel_pass);
+    CHECK(original_rows == rows);
+    CHECK(ds.rows() == rows);
+    CHECK(parallel.rows() == rows);
+}
+
+TEST_CASE("benchmark/attach", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 200000;
+#else
+    size_t const rows = 20000;
+#endif
+    benchmark_attach(generate_csv(rows, 12), rows);
+}
+
+TEST_CASE("benchmark/attach wide records", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 4000;
+#else
+    size_t const rows = 400;
+#endif
+    // many short fields per record, so per-field overheads dominate
+    auto const csv = generate_csv(rows, 500);
+    std::cout << "\nattach " << rows << " rows of 500 columns, " << csv.length() << " bytes\n";
+
+    // the same reader with each kind of sink, then the dataset itself
+    size_t bound_rows = 0;
+    auto const bound = seconds([&csv, &bound_rows]() {
+        bound_rows = original::attach_bound(csv.data(), csv.data() + csv.length());
+    });
+
+    size_t inlined_rows = 0;
+    auto const inlined = seconds([&csv, &inlined_rows]() {
+        inlined_rows = original::attach_inlined(csv.data(), csv.data() + csv.length());
+    });
+
+    dataset ds;
+    auto const elapsed = seconds([&csv, &ds]() {
+        ds.attach(csv.data(), csv.data() + csv.length());
+    });
+
+    auto const fields = [rows](double seconds) { return rows * 500 / seconds / 1e6; };
+    std::cout << std::fixed << std::setprecision(1)
+              << "    std::function sink: " << fields(bound) << " million fields/s\n"
+              << "    lambda sink       : " << fields(inlined) << " million fields/s\n"
+              << "    dataset::attach   : " << fields(elapsed) << " million fields/s\n";
+    CHECK(bound_rows == rows);
+    CHECK(inlined_rows == rows);
+    CHECK(ds.rows() == rows);
+}
+
+TEST_CASE("benchmark/attach long text fields", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 20000;
+#else
+    size_t const rows = 2000;
+#endif
+    // similar to image data or the body of a post, with a few short
+    // fields and one long field per record
+    std::ostringstream csv;
+    csv << "id,score,body\n";
+    for (size_t row=0; row<rows; ++row)
+    {
+        csv << row << ',' << (row % 97) << ".5,\"";
+        for (size_t word=0; word<150; ++word)
+            csv << "word" << (row + word) % 1000 << ' ';
+        csv << "\"\n";
+    }
+    benchmark_attach(csv.str(), rows);
+}
+
+TEST_CASE("benchmark/attach projection", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 200000;
+#else
+    size_t const rows = 20000;
+#endif
+    auto const csv = generate_csv(rows, 12);
+    std::cout << "\nattach 2 of 12 columns, " << rows << " rows, " << csv.length() << " bytes\n";
+
+    dataset all;
+    auto const all_columns = seconds([&csv, &all]() {
+        all.attach(csv.data(), csv.data() + csv.length());
+    });
+
+    std::vector<size_t> indices;
+    indices.push_back(0);
+    indices.push_back(5);
+    dataset projected;
+    auto const projected_columns = seconds([&csv, &projected, &indices]() {
+        projected.attach(csv.data(), csv.data() + csv.length(), cdmh::data_processing::column_projection(indices));
+    });
+
+    report("all columns", csv.length(), all_columns);
+    report("projected  ", csv.length(), projected_columns);
+    CHECK(projected.columns() == 2);
+    CHECK(projected.rows() == rows);
+}
+
+TEST_CASE("benchmark/lazy attach", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 200000;
+#else
+    size_t const rows = 20000;
+#endif
+    auto const csv = generate_csv(rows, 12);
+    std::cout << "\nlazy attach " << rows << " rows, " << csv.length() << " bytes\n";
+
+    dataset full;
+    auto const full_attach = seconds([&csv, &full]() {
+        full.attach(csv.data(), csv.data() + csv.length());
+    });
+
+    dataset lazy;
+    auto const lazy_attach = seconds([&csv, &lazy]() {
+        lazy.attach_lazy(csv.data(), csv.data() + csv.length());
+    });
+
+    double sum = 0.0;
+    auto const one_column = seconds([&lazy, &sum]() {
+        sum = lazy.column(4).sum<double>();
+    });
+
+    report("full attach          ", csv.length(), full_attach);
+    report("lazy attach          ", csv.length(), lazy_attach);
+    report("lazy attach, 1 column", csv.length(), lazy_attach + one_column);
+    CHECK(lazy.rows() == rows);
+    CHECK(sum == full.column(4).sum<double>());
+}
+
+TEST_CASE("benchmark/attach row range", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 200000;
+#else
+    size_t const rows = 20000;
+#endif
+    auto const csv = generate_csv(rows, 12);
+    std::cout << "\nattach the last 1% of " << rows << " rows, " << csv.length() << " bytes\n";
+
+    dataset full;
+    auto const full_attach = seconds([&csv, &full]() {
+        full.attach(csv.data(), csv.data() + csv.length());
+    });
+
+    std::unique_ptr<cdmh::data_processing::record_index> index;
+    auto const indexing = seconds([&csv, &index]() {
+        index.reset(new cdmh::data_processing::record_index(csv.data(), csv.data() + csv.length()));
+    });
+
+    dataset range;
+    auto const range_attach = seconds([&index, &range, rows]() {
+        range.attach_rows(*index, rows - rows / 100, rows);
+    });
+
+    report("full attach ", csv.length(), full_attach);
+    report("record index", csv.length(), indexing);
+    std::cout << "    attach rows: " << std::setprecision(2) << range_attach * 1000.0 << " ms, "
+              << "full attach: " << full_attach * 1000.0 << " ms\n";
+    CHECK(range.rows() == rows / 100);
+}
+
+TEST_CASE("benchmark/column operations", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 1000000;
+#else
+    size_t const rows = 100000;
+#endif
+    std::ostringstream stream;
+    stream << "id,score\n";
+    for (size_t row=0; row<rows; ++row)
+        stream << row << ',' << (row % 1000) << '.' << (row % 7) << "\n";
+    auto const csv = stream.str();
+
+    dataset ds;
+    ds.attach(csv.data(), csv.data() + csv.length());
+    std::cout << "\ncolumn operations over " << rows << " rows\n";
+
+    // parsing the text of each cell, as column operations did previously
+    double parsed_sum = 0.0;
+    auto const parsed = seconds([&ds, &parsed_sum]() {
+        for (auto const &cell : ds.cells(1))
+            parsed_sum += cell.get<double>();
+    });
+
+    double native_sum = 0.0;
+    auto const native = seconds([&ds, &native_sum]() {
+        native_sum = ds.column(1).sum<double>();
+    });
+
+    // counting nulls by testing each cell, as count_null did previously
+    size_t cell_nulls = 0;
+    auto const cell_count = seconds([&ds, &cell_nulls]() {
+        auto const &cells = ds.cells(1);
+        cell_nulls = std::count_if(cells.begin(), cells.end(), [](dataset::cell_value const &cell) { return cell.is_null(); });
+    });
+
+    size_t bitmap_nulls = 0;
+    auto const bitmap_count = seconds([&ds, &bitmap_nulls]() {
+        bitmap_nulls = ds.column(1).count_null();
+    });
+
+    double sd = 0.0;
+    auto const standard_deviation = seconds([&ds, &sd]() {
+        sd = ds.column(1).standard_deviation();
+    });
+
+    std::cout << std::setprecision(2)
+              << "    sum, parsing cells     : " << parsed * 1000.0 << " ms\n"
+              << "    sum, native values     : " << native * 1000.0 << " ms\n"
+              << "    count nulls, cells     : " << cell_count * 1000.0 << " ms\n"
+              << "    count nulls, bitmap    : " << bitmap_count * 1000.0 << " ms\n"
+              << "    standard deviation     : " << standard_deviation * 1000.0 << " ms\n";
+    CHECK(std::abs(parsed_sum - native_sum) < 1e-6 * parsed_sum);
+    CHECK(cell_nulls == bitmap_nulls);
+    CHECK(sd > 0.0);
+}
+
+TEST_CASE("benchmark/row estimate", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 1000000;
+#else
+    size_t const rows = 100000;
+#endif
+    auto const csv = generate_csv(rows, 12);
+    char const *begin = csv.data();
+    std::cout << "\nrow estimate " << rows << " rows, " << csv.length() << " bytes\n";
+
+    size_t estimate = 0;
+    auto const estimate_time = seconds([&csv, &estimate]() {
+        estimate = cdmh::data_processing::detail::estimate_records(csv.data(), csv.data() + csv.length());
+    });
+
+    dataset ds;
+    auto const attach_time = seconds([&ds, begin, &csv]() {
+        ds.attach(begin, begin + csv.length());
+    });
+
+    std::cout << std::setprecision(3)
+              << "    estimate               : " << estimate << " rows in " << estimate_time * 1000.0 << " ms\n"
+              << "    attach                 : " << ds.rows() << " rows in " << attach_time * 1000.0 << " ms\n";
+    CHECK(estimate > rows * 9 / 10);
+    CHECK(estimate < rows * 11 / 10);
+}
+
+TEST_CASE("benchmark/snapshot", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 1000000;
+#else
+    size_t const rows = 100000;
+#endif
+    auto const csv = generate_csv(rows, 12);
+    char const *begin = csv.data();
+    std::cout << "\nsnapshot " << rows << " rows, " << csv.length() << " bytes\n";
+
+    dataset ds;
+    auto const attach = seconds([&ds, begin, &csv]() {
+        ds.attach(begin, begin + csv.length());
+        ds.column(0).sum<double>();
+    });
+
+    auto const save = seconds([&ds]() { ds.save_snapshot("benchmark.dps"); });
+
+    size_t snapshot_rows = 0;
+    double sum = 0.0;
+    auto const open = seconds([&snapshot_rows, &sum]() {
+        dataset snapshot;
+        snapshot.open_snapshot("benchmark.dps");
+        snapshot_rows = snapshot.rows();
+        sum = snapshot.column(0).sum<double>();
+    });
+    std::remove("benchmark.dps");
+
+    std::cout << std::setprecision(3)
+              << "    attach CSV             : " << attach * 1000.0 << " ms\n"
+              << "    save snapshot          : " << save * 1000.0 << " ms\n"
+              << "    open snapshot          : " << open * 1000.0 << " ms\n";
+    CHECK(snapshot_rows == rows);
+    CHECK(sum == ds.column(0).sum<double>());
+}
+
+TEST_CASE("benchmark/compact cells", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 1000000;
+#else
+    size_t const rows = 100000;
+#endif
+    auto const csv = generate_csv(rows, 4);
+    char const *begin = csv.data();
+    dataset ds;
+    ds.attach(begin, begin + csv.length());
+    std::cout << "\ncompact cells over " << rows << " rows\n";
+
+    // a copy of the cells as string_views, as they were stored previously
+    std::vector<dataset::cell_value> wide(ds.cells(1).begin(), ds.cells(1).end());
+
+    size_t wide_length = 0;
+    auto const wide_scan = seconds([&wide, &wide_length]() {
+        for (auto const &cell : wide)
+            wide_length += cell.get<string_view>().length();
+    });
+
+    size_t compact_length = 0;
+    auto const compact_scan = seconds([&ds, &compact_length]() {
+        for (auto const &cell : ds.cells(1))
+            compact_length += cell.get<string_view>().length();
+    });
+
+    std::cout << std::setprecision(2)
+              << "    string_view cells      : " << wide_scan * 1000.0 << " ms, " << sizeof(string_view) << " bytes a cell\n"
+              << "    compact cells          : " << compact_scan * 1000.0 << " ms, " << 2 * sizeof(std::uint32_t) << " bytes a cell\n";
+    CHECK(!ds.cells(1).is_wide());
+    CHECK(wide_length == compact_length);
+}
+
+TEST_CASE("benchmark/dictionary encoding", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 1000000;
+#else
+    size_t const rows = 100000;
+#endif
+    char const *const tags[] = { "news", "sport", "weather", "finance", "travel", "science", "music", "film" };
+    std::ostringstream stream;
+    stream << "id,tag\n";
+    for (size_t row=0; row<rows; ++row)
+        stream << row << ',' << tags[(row * 7919) % 8] << "\n";
+    auto const csv = stream.str();
+
+    dataset ds;
+    ds.attach(csv.data(), csv.data() + csv.length());
+    std::cout << "\ndictionary encoding over " << rows << " rows\n";
+
+    // comparing the text of each cell
+    size_t compared = 0;
+    auto const compare = seconds([&ds, &compared]() {
+        for (auto const &cell : ds.cells(1))
+        {
+            if (cell.get<string_view>() == "weather")
+                ++compared;
+        }
+    });
+
+    auto const encode = seconds([&ds]() { ds.column(1).codes(); });
+
+    size_t matched = 0;
+    auto const match = seconds([&ds, &matched]() {
+        matched = ds.column(1).rows_matching("weather").size();
+    });
+
+    size_t groups = 0;
+    auto const group = seconds([&ds, &groups]() {
+        groups = ds.column(1).value_counts().size();
+    });
+
+    std::cout << std::setprecision(2)
+              << "    filter, comparing cells: " << compare * 1000.0 << " ms\n"
+              << "    encode                 : " << encode * 1000.0 << " ms\n"
+              << "    filter, comparing codes: " << match * 1000.0 << " ms\n"
+              << "    value counts           : " << group * 1000.0 << " ms\n";
+    CHECK(compared == matched);
+    CHECK(groups == 8);
+}
+
+TEST_CASE("benchmark/column statistics", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 1000000;
+#else
+    size_t const rows = 100000;
+#endif
+    // the values repeat, and every tenth value is 42, so that the
+    // column has a mode at either size
+    std::ostringstream stream;
+    stream << "value\n";
+    for (size_t row=0; row<rows; ++row)
+        stream << ((row % 10 == 0)? 42 : (row * 7919) % 1000) << "\n";
+    auto const csv = stream.str();
+
+    dataset ds;
+    ds.attach(csv.data(), csv.data() + csv.length());
+    std::cout << "\nmedian, mode and standard deviation of " << rows << " rows, 5 times\n";
+
+    // extracting the column for each statistic, as they were previously
+    double extracted = 0.0;
+    auto const extract = seconds([&ds, &extracted]() {
+        for (int loop=0; loop<5; ++loop)
+        {
+            extracted += cdmh::data_processing::maths::median(ds.extract_column<std::int64_t>(0, false));
+            extracted += cdmh::data_processing::maths::mode(ds.extract_column<std::int64_t>(0, false));
+            extracted += cdmh::data_processing::maths::standard_deviation(ds.extract_column<std::int64_t>(0, false));
+        }
+    });
+
+    double cached = 0.0;
+    auto const cache = seconds([&ds, &cached]() {
+        for (int loop=0; loop<5; ++loop)
+            cached += ds.column(0).median() + ds.column(0).mode() + ds.column(0).standard_deviation();
+    });
+
+    std::cout << std::setprecision(2)
+              << "    extract each time      : " << extract * 1000.0 << " ms\n"
+              << "    sorted values, cached  : " << cache * 1000.0 << " ms\n";
+    CHECK(ds.column(0).mode() == 42);
+    CHECK(fabs(extracted - cached) < 0.0001 * cached);
+}
+
+TEST_CASE("benchmark/number parsing", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 1000000;
+#else
+    size_t const rows = 100000;
+#endif
+    std::ostringstream stream;
+    stream << "integer,double\n" << std::setprecision(17);
+    for (size_t row=0; row<rows; ++row)
+        stream << std::int64_t(row * 2654435761) * ((row & 1)? -1 : 1) << ',' << double(row * 7919) / 997.0 << "\n";
+    auto const csv = stream.str();
+
+    dataset ds;
+    ds.attach(csv.data(), csv.data() + csv.length());
+    std::cout << "\nparsing " << rows << " values\n";
+
+    // strtoll and strtod stop at the delimiter after each value, so the
+    // values are parsed in place
+    std::int64_t libc_integers = 0;
+    auto const strtoll_time = seconds([&ds, &libc_integers]() {
+        for (auto const &cell : ds.cells(0))
+            libc_integers += strtoll(cell.get<string_view>().begin(), nullptr, 10);
+    });
+
+    std::int64_t integers = 0;
+    auto const integer_time = seconds([&ds, &integers]() {
+        for (auto const &cell : ds.cells(0))
+        {
+            std::int64_t value = 0;
+            auto const text = cell.get<string_view>();
+            if (cdmh::data_processing::detail::parse_integer(text.begin(), text.end(), value))
+                integers += value;
+        }
+    });
+
+    double libc_doubles = 0.0;
+    auto const strtod_time = seconds([&ds, &libc_doubles]() {
+        for (auto const &cell : ds.cells(1))
+            libc_doubles += strtod(cell.get<string_view>().begin(), nullptr);
+    });
+
+    double doubles = 0.0;
+    auto const double_time = seconds([&ds, &doubles]() {
+        for (auto const &cell : ds.cells(1))
+        {
+            double value = 0.0;
+            auto const text = cell.get<string_view>();
+            if (cdmh::data_processing::detail::parse_double(text.begin(), text.end(), value))
+                doubles += value;
+        }
+    });
+
+    std::cout << std::setprecision(3)
+              << "    strtoll                : " << strtoll_time * 1000.0 << " ms\n"
+              << "    parse_integer          : " << integer_time * 1000.0 << " ms\n"
+              << "    strtod                 : " << strtod_time * 1000.0 << " ms\n"
+              << "    parse_double           : " << double_time * 1000.0 << " ms\n";
+    CHECK(libc_integers == integers);
+    CHECK(libc_doubles == doubles);
+}
+
+TEST_CASE("benchmark/ingest statistics", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 1000000;
+#else
+    size_t const rows = 100000;
+#endif
+    std::ostringstream stream;
+    stream << "id,count,price,score\n";
+    for (size_t row=0; row<rows; ++row)
+    {
+        stream << row << ',';
+        if (row % 7)
+            stream << (row * 7919) % 1000;
+        stream << ',' << (row % 1000) << '.' << (row % 100) << ',';
+        if (row % 5)
+            stream << (row % 997) << ".125";
+        stream << "\n";
+    }
+    auto const csv = stream.str();
+    char const *begin = csv.data();
+    std::cout << "\nstatistics of 4 numeric columns of " << rows << " rows, 100 times\n";
+
+    dataset scanned;
+    auto const attach = seconds([&scanned, begin, &csv]() {
+        scanned.attach(begin, begin + csv.length());
+    });
+
+    dataset collected;
+    collected.collect_statistics();
+    auto const attach_collecting = seconds([&collected, begin, &csv]() {
+        collected.attach(begin, begin + csv.length());
+    });
+
+    // the summary that a dashboard would show, for each numeric column
+    auto summarise = [](dataset const &ds) {
+        double total = 0.0;
+        for (int loop=0; loop<100; ++loop)
+        {
+            for (size_t column=0; column<ds.columns(); ++column)
+            {
+                auto const data = ds.column(column);
+                total += data.count() + data.count_null();
+                total += data.min<double>() + data.max<double>() + data.sum<double>();
+            }
+        }
+        return total;
+    };
+
+    double scanned_total   = 0.0;
+    double collected_total = 0.0;
+    auto const scan    = seconds([&]() { scanned_total   = summarise(scanned);   });
+    auto const collect = seconds([&]() { collected_total = summarise(collected); });
+
+    std::cout << std::setprecision(3)
+              << "    attach                 : " << attach * 1000.0 << " ms\n"
+              << "    attach with statistics : " << attach_collecting * 1000.0 << " ms\n"
+              << "    reading the columns    : " << scan * 1000.0 << " ms\n"
+              << "    collected statistics   : " << collect * 1000.0 << " ms\n";
+    CHECK(fabs(scanned_total - collected_total) < 1e-9 * fabs(scanned_total));
+}
+
+TEST_CASE("benchmark/describe", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 1000000;
+#else
+    size_t const rows = 100000;
+#endif
+    size_t const columns = 8;
+    std::ostringstream stream;
+    for (size_t column=0; column<columns; ++column)
+        stream << (column? "," : "") << "column" << column;
+    stream << "\n";
+    for (size_t row=0; row<rows; ++row)
+    {
+        for (size_t column=0; column<columns; ++column)
+        {
+            stream << (column? "," : "");
+            if ((row + column) % 11)
+                stream << (row * (column + 7919)) % 100003 << ((column & 1)? ".5" : "");
+        }
+        stream << "\n";
+    }
+    auto const csv = stream.str();
+
+    dataset ds;
+    ds.attach(csv.data(), csv.data() + csv.length());
+    std::cout << "\ndescribe " << columns << " numeric columns of " << rows << " rows\n";
+
+    // a call for each statistic of each column
+    double separate_total = 0.0;
+    auto const separate = seconds([&ds, &separate_total]() {
+        for (size_t column=0; column<ds.columns(); ++column)
+        {
+            auto const data = ds.column(column);
+            separate_total += data.count() + data.mean() + data.min<double>() + data.max<double>() + data.standard_deviation();
+        }
+    });
+
+    std::vector<cdmh::data_processing::column_summary> summary;
+    auto const serial = seconds([&ds, &summary]() { summary = ds.describe(1); });
+    auto const parallel = seconds([&ds, &summary]() { summary = ds.describe(); });
+
+    double describe_total = 0.0;
+    for (auto const &column : summary)
+        describe_total += column.count + column.mean + column.min + column.max + column.standard_deviation;
+
+    std::cout << std::setprecision(3)
+              << "    separate calls         : " << separate * 1000.0 << " ms\n"
+              << "    describe, one thread   : " << serial * 1000.0 << " ms\n"
+              << "    describe               : " << parallel * 1000.0 << " ms\n";
+    CHECK(summary.size() == columns);
+    CHECK(fabs(separate_total - describe_total) < 1e-9 * separate_total);
+}
+
+TEST_CASE("benchmark/reductions", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 1000000;
+#else
+    size_t const rows = 100000;
+#endif
+    using namespace cdmh::data_processing::detail;
+
+    // one row in sixteen is null, so few words of the null bitmap have
+    // every bit set
+    std::vector<std::uint64_t> valid((rows + 63) / 64);
+    std::vector<std::int64_t>  integers(rows);
+    std::vector<double>        doubles(rows);
+    for (size_t row=0; row<rows; ++row)
+    {
+        if ((row * 7919) % 16 == 0)
+            continue;
+        valid[row / 64] |= std::uint64_t(1) << (row % 64);
+        integers[row] = std::int64_t((row * 7919) % 100003) - 50000;
+        doubles[row]  = integers[row] + 0.5;
+    }
+
+    size_t const repeat = 20;
+    std::cout << "\nreductions of " << rows << " rows, " << repeat << " times\n";
+
+    // the loops of column_data before the kernels
+    double baseline_total = 0.0;
+    auto const baseline = seconds([&]() {
+        for (size_t loop=0; loop<repeat; ++loop)
+        {
+            std::int64_t min = std::numeric_limits<std::int64_t>::max();
+            double squares = 0.0;
+            size_t count = 0;
+            for (size_t row=0; row<rows; ++row)
+            {
+                if (valid[row / 64] & (std::uint64_t(1) << (row % 64)))
+                    min = std::min(min, integers[row]);
+                squares += doubles[row] * doubles[row];
+            }
+            for (auto word : valid)
+                count += popcount(word);
+            baseline_total += std::accumulate(integers.begin(), integers.end(), std::int64_t())
+                            + std::accumulate(doubles.begin(), doubles.end(), 0.0)
+                            + min + squares + count;
+        }
+    });
+    std::cout << std::setprecision(3)
+              << "    accumulate and loops   : " << baseline * 1000.0 << " ms\n";
+
+    char const *const names[] = { "scalar kernels         : ", "AVX2 kernels           : ", "AVX-512 kernels        : " };
+    for (int level=scalar_kernels; level<=supported_simd_level(); ++level)
+    {
+        auto const kernels = simd_level(level);
+        double total = 0.0;
+        auto const elapsed = seconds([&]() {
+            for (size_t loop=0; loop<repeat; ++loop)
+            {
+                std::int64_t min, max;
+                reduce_min_max(integers.data(), valid.data(), valid.size(), min, max, kernels);
+                total += reduce_sum(integers.data(), rows, kernels)
+                       + reduce_sum(doubles.data(), rows, kernels)
+                       + min
+                       + reduce_sum_of_squares(doubles.data(), rows, kernels)
+                       + count_set_bits(valid.data(), valid.size(), kernels);
+            }
+        });
+        std::cout << "    " << names[level] << elapsed * 1000.0 << " ms\n";
+        CHECK(fabs(total - baseline_total) <= fabs(baseline_total) * 1e-9);
+    }
+}
+
+#ifdef DATA_PROCESSING_USE_ZLIB
+TEST_CASE("benchmark/compressed reader", "[benchmark][hide]")
+{
+#ifdef NDEBUG
+    size_t const rows = 200000;
+#else
+    size_t const rows = 20000;
+#endif
+    auto const csv = generate_csv(rows, 12);
+    gzFile file = gzopen("benchmark.csv.gz", "wb");
+    gzwrite(file, csv.data(), (unsigned)csv.length());
+    gzclose(file);
+    std::cout << "\ncompressed reader " << rows << " rows, " << csv.length() << " bytes\n";
+
+    // decompress the whole file, then attach
+    size_t serial_rows = 0;
+    auto const serial = seconds([&csv, &serial_rows]() {
+        std::vector<char> data(csv.length());
+        gzFile file = gzopen("benchmark.csv.gz", "rb");
+        gzread(file, &data[0], (unsigned)data.size());
+        gzclose(file);
+
+        char const *begin = data.data();
+        dataset ds;
+        ds.attach(begin, begin + data.size());
+        serial_rows = ds.rows();
+    });
+
+    // decompress on a separate thread, while the blocks are read
+    size_t pipelined_rows = 0;
+    auto const pipelined = seconds([&pipelined_rows]() {
+        cdmh::data_processing::compressed_reader reader("benchmark.csv.gz", 1024 * 1024);
+        while (reader.next())
+            pipelined_rows += reader.group().rows();
+    });
+    std::remove("benchmark.csv.gz");
+
+    report("decompress, then attach", csv.length(), serial);
+    report("pipelined              ", csv.length(), pipelined);
+    CHECK(serial_rows == rows);
+    CHECK(pipelined_rows == rows);
+}
+#endif
+
+}   // anonymous namespace
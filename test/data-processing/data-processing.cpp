@@ -4,6 +4,8 @@
 
 #include "stdafx.h"
 #include <iostream>
+#include <random>
+#include <set>
 #include "data-processing.h"
 
 #define CATCH_CONFIG_RUNNER
@@ -49,6 +51,24 @@ TEST_CASE("read_field/string fields starting with numerics", "")
     CHECK(read_field("a8.34").second == string_type);
 }
 
+TEST_CASE("read_field/numeric edge cases", "")
+{
+    CHECK(read_field(".5").second == double_type);
+    CHECK(read_field("5.").second == double_type);
+    CHECK(read_field("-.5").second == double_type);
+    CHECK(read_field(".").second == string_type);
+    CHECK(read_field("-.").second == string_type);
+    CHECK(read_field("+.").second == string_type);
+    CHECK(read_field("-").second == string_type);
+    CHECK(read_field("+").second == string_type);
+    CHECK(read_field("+-5").second == string_type);
+    CHECK(read_field("5-").second == string_type);
+    CHECK(read_field("12 34").second == string_type);
+    CHECK(read_field("\"1234\"").second == string_type);
+    CHECK(read_field("").second == null_type);
+    CHECK(read_field("   ").second == null_type);
+}
+
 TEST_CASE("read_field/numerics with padding", "")
 {
     CHECK(read_field("8374 ").second == integer_type);
@@ -80,6 +100,1335 @@ TEST_CASE("read_field/spaces around quoted string with leading & trailing spaces
     CHECK(std::distance(field.first.begin(), field.first.end()) == 15);
 }
 
+TEST_CASE("read_field/fields spanning scanner blocks", "")
+{
+    // escaped quotes and delimiters either side of 64 byte block boundaries
+    std::string record(
+        "\"0123456789012345678901234567890123456789012345678901234567890\"\"\"\"12\","
+        "012345678901234567890123456789012345678901234567890123456789012345678,x");
+    auto it  = record.c_str();
+    auto ite = it + record.length();
+    cdmh::data_processing::detail::structural_scanner scanner(ite);
+    auto field1 = cdmh::data_processing::detail::read_field(scanner, it, ite);
+    CHECK(field1.second == string_type);
+    CHECK(field1.first.length() == 67);
+    REQUIRE(*it == ',');
+    auto field2 = cdmh::data_processing::detail::read_field(scanner, ++it, ite);
+    CHECK(field2.second == integer_type);
+    CHECK(field2.first.length() == 69);
+    REQUIRE(*it == ',');
+    auto field3 = cdmh::data_processing::detail::read_field(scanner, ++it, ite);
+    CHECK(field3.second == string_type);
+    CHECK(it == ite);
+}
+
+TEST_CASE("read_field/number parsing", "")
+{
+    using cdmh::data_processing::detail::parse_integer;
+    using cdmh::data_processing::detail::parse_double;
+
+    auto integer = [](char const *value, std::int64_t &result) {
+        return parse_integer(value, value + strlen(value), result);
+    };
+    std::int64_t number = 0;
+    CHECK((integer("0", number)  &&  number == 0));
+    CHECK((integer("-12", number)  &&  number == -12));
+    CHECK((integer("+12345678", number)  &&  number == 12345678));
+    CHECK((integer("1234567890123", number)  &&  number == 1234567890123));
+    CHECK((integer("00000000000000000000042", number)  &&  number == 42));
+    CHECK((integer("9223372036854775807", number)  &&  number == INT64_MAX));
+    CHECK((integer("-9223372036854775808", number)  &&  number == INT64_MIN));
+    CHECK(!integer("9223372036854775808", number));
+    CHECK(!integer("99999999999999999999", number));
+    CHECK(!integer("12345678x", number));
+    CHECK(!integer("1234567x9", number));
+    CHECK(!integer("-", number));
+    CHECK(!integer("", number));
+
+    // doubles are the same as strtod, bit for bit
+    auto same_as_strtod = [](char const *value) -> bool {
+        double result = 0.0;
+        double const expected = strtod(value, nullptr);
+        return parse_double(value, value + strlen(value), result)
+           &&  memcmp(&result, &expected, sizeof(result)) == 0;
+    };
+    char const *const values[] = {
+        "0", "-0", "1.", ".5", "-2.25", "0.1", "3.141592653589793", "1e10", "1E-10", "2.5e+3",
+        "9007199254740993", "1.7976931348623157e308", "1.8e308", "2.2250738585072014e-308",
+        "4.9e-324", "2e-324", "1e-400", "123456789012345678901234567890", "0.000000000000000000000000001",
+        "7.2057594037927933e16", "9007199254740992.5", "inf", "-nan"
+    };
+    for (auto value : values)
+        CHECK(same_as_strtod(value));
+    double result;
+    CHECK(!parse_double(".", strchr(".", 0), result));
+    CHECK(!parse_double("1e", strchr("1e", 0), result));
+    CHECK(!parse_double("1.2.3", strchr("1.2.3", 0), result));
+
+    std::mt19937_64 generator(2013);
+    size_t mismatches = 0;
+    for (int loop=0; loop<100000; ++loop)
+    {
+        std::uint64_t bits = generator();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (value != value  ||  value - value != 0.0)
+            continue;
+
+        char buffer[64];
+        sprintf(buffer, "%.*g", int(loop % 17 + 1), value);
+        if (!same_as_strtod(buffer))
+            ++mismatches;
+        sprintf(buffer, "%llu.%llue%d", (unsigned long long)(generator() % 100000), (unsigned long long)(generator() % 1000000000), int(generator() % 700) - 350);
+        if (!same_as_strtod(buffer))
+            ++mismatches;
+    }
+    CHECK(mismatches == 0);
+
+    CHECK(cdmh::data_processing::split_string<std::int64_t>(std::string("12,-3, 4000000000"), ',') == std::vector<std::int64_t>({ 12, -3, 4000000000 }));
+    CHECK(cdmh::data_processing::split_string<double>(std::string("1.5 -2"), ' ') == std::vector<double>({ 1.5, -2.0 }));
+}
+
+TEST_CASE("dataset/record boundaries", "")
+{
+    char const *data =
+        "col1,col2,col3\r\n"
+        "1 ,\"two\"  ,\r\n"
+        "\r\n"
+        "4,\"\",\"line\nbreak\"\n"
+        "7,\"eight\",9";
+
+    cdmh::data_processing::dataset ds;
+    ds.attach(data);
+    REQUIRE(ds.columns() == 3);
+    REQUIRE(ds.rows() == 3);
+    CHECK(ds[0][0].get<std::uint32_t>() == 1);
+    CHECK(ds[0][1].get<std::string>() == "two");
+    CHECK(ds[0][2].is_null());
+    CHECK(ds[1][1].is_null());
+    CHECK(ds[1][2].get<std::string>() == "line\nbreak");
+    CHECK(ds[2][2].get<std::uint32_t>() == 9);
+}
+
+TEST_CASE("dataset/parallel attach", "")
+{
+    // quoted fields with line breaks and delimiters, so that chunk
+    // boundaries have to be found around them
+    std::ostringstream stream;
+    stream << "id,value,text\r\n";
+    for (int loop=0; loop<20000; ++loop)
+    {
+        stream << loop << ',' << ((loop == 15000)? "" : "2.5") << ",\"text " << loop;
+        if (loop % 7 == 0)
+            stream << "\nover \"\"two\"\",\r\nlines";
+        stream << "\"\r\n";
+    }
+    auto const data = stream.str();
+
+    cdmh::data_processing::dataset serial;
+    serial.attach(data.c_str());
+
+    cdmh::data_processing::dataset parallel;
+    parallel.attach_parallel(data.c_str(), data.c_str() + data.length(), 7);
+
+    REQUIRE(parallel.columns() == 3);
+    REQUIRE(parallel.rows() == serial.rows());
+    CHECK(parallel.rows() == 20000);
+    CHECK(parallel.column(0).is_integer());
+    CHECK(parallel.column(1).is_double());
+    CHECK(parallel.column(1).count_null() == 1);
+    CHECK(parallel.column(2).is_string());
+    for (size_t loop=0; loop<parallel.rows(); ++loop)
+    {
+        if (parallel[loop][0].get<std::uint32_t>() != loop
+        ||  parallel[loop][2].get<std::string>() != serial[loop][2].get<std::string>())
+        {
+            FAIL("Row " << loop << " differs");
+        }
+    }
+}
+
+TEST_CASE("row_group_reader", "")
+{
+    std::ostringstream stream;
+    stream << "id,value,text\n";
+    for (int loop=0; loop<1000; ++loop)
+        stream << loop << ',' << (loop % 10) << ".5,\"line\n" << loop << "\"\n";
+    auto const data = stream.str();
+
+    cdmh::data_processing::row_group_reader reader(data.c_str(), data.c_str() + data.length(), 300);
+    std::vector<size_t> group_sizes;
+    double sum = 0.0;
+    std::uint32_t expected_id = 0;
+    while (reader.next())
+    {
+        auto const &group = reader.group();
+        REQUIRE(group.columns() == 3);
+        CHECK(group.column_title(1) == "value");
+        CHECK(reader.first_row() == expected_id);
+        CHECK(group[0][0].get<std::uint32_t>() == expected_id);
+        CHECK(group.column(1).is_double());
+        group_sizes.push_back(group.rows());
+        sum += group.column(1).sum<double>();
+        expected_id += (std::uint32_t)group.rows();
+    }
+
+    REQUIRE(group_sizes.size() == 4);
+    CHECK(group_sizes[0] == 300);
+    CHECK(group_sizes[3] == 100);
+    CHECK(sum == 5000.0);
+}
+
+TEST_CASE("dataset/dialects", "")
+{
+    using cdmh::data_processing::tsv_dialect;
+    using cdmh::data_processing::psv_dialect;
+
+    SECTION("tab separated") {
+        // leading empty fields must not be trimmed as padding
+        char const *data =
+            "id\tname\tscore\n"
+            "\tone, two\t1.5\n"
+            "2\t \"three\tfour\" \t\n";
+
+        cdmh::data_processing::dataset ds;
+        ds.attach<tsv_dialect>(data);
+        REQUIRE(ds.columns() == 3);
+        REQUIRE(ds.rows() == 2);
+        CHECK(ds[0][0].is_null());
+        CHECK(ds[0][1].get<std::string>() == "one, two");
+        CHECK(ds[1][0].get<std::uint32_t>() == 2);
+        CHECK(ds[1][1].get<std::string>() == "three\tfour");
+        CHECK(ds[1][2].is_null());
+        CHECK(ds.column(2).is_double());
+    }
+
+    SECTION("pipe separated") {
+        char const *data =
+            "id|name\r\n"
+            "1|a,b\r\n"
+            "2|\"c|d\"\r\n";
+
+        cdmh::data_processing::dataset ds;
+        ds.attach<psv_dialect>(data);
+        REQUIRE(ds.columns() == 2);
+        REQUIRE(ds.rows() == 2);
+        CHECK(ds[0][1].get<std::string>() == "a,b");
+        CHECK(ds[1][1].get<std::string>() == "c|d");
+
+        cdmh::data_processing::dataset parallel;
+        parallel.attach_parallel<psv_dialect>(data, data + strlen(data), 2);
+        CHECK(parallel.rows() == 2);
+    }
+}
+
+TEST_CASE("dataset/attach with schema", "")
+{
+    using cdmh::data_processing::dataset;
+    char const *data =
+        "id,score,name\n"
+        "1,2.5,one\n"
+        "2,x,two\n"
+        "-9223372036854775808,,123\n";
+
+    std::vector<cdmh::data_processing::column_schema> schema;
+    schema.push_back(cdmh::data_processing::column_schema("id", integer_type, false));
+    schema.push_back(cdmh::data_processing::column_schema("score", double_type));
+    schema.push_back(cdmh::data_processing::column_schema("name", string_type));
+
+    SECTION("typed values") {
+        dataset ds;
+        ds.attach(data, data + strlen(data), schema);
+        REQUIRE(ds.columns() == 3);
+        REQUIRE(ds.rows() == 3);
+        CHECK(ds.column_type(0) == integer_type);
+        CHECK(ds.column_type(1) == double_type);
+        CHECK(ds.column_type(2) == string_type);
+        CHECK(ds[2][1].is_null());
+        CHECK(ds[2][2].get<std::string>() == "123");
+        CHECK(ds.column(1).sum<double>() == 2.5);
+
+        // the non-numeric score is invalid, the missing score is nullable
+        REQUIRE(ds.invalid_cells().size() == 1);
+        CHECK(ds.invalid_cells()[0] == dataset::cell_position_t(1, 1));
+        CHECK(ds[1][1].is_null());
+    }
+
+    SECTION("mismatched header") {
+        schema[1] = cdmh::data_processing::column_schema("value", double_type);
+        dataset ds;
+        CHECK_THROWS_AS(ds.attach(data, data + strlen(data), schema), dataset::schema_mismatch);
+        CHECK(!ds.is_attached());
+        CHECK(ds.columns() == 0);
+
+        schema[1] = cdmh::data_processing::column_schema("score", double_type);
+        ds.attach(data, data + strlen(data), schema);
+        CHECK(ds.rows() == 3);
+    }
+
+    SECTION("extra field") {
+        char const *extra =
+            "id,score,name\n"
+            "1,2.5,one\n"
+            "2,3.5,two,three\n";
+        dataset ds;
+        CHECK_THROWS_AS(ds.attach(extra, extra + strlen(extra), schema), dataset::schema_mismatch);
+        CHECK(!ds.is_attached());
+        CHECK(ds.columns() == 0);
+
+        // the dataset can be attached again
+        ds.attach(data, data + strlen(data), schema);
+        CHECK(ds.rows() == 3);
+        CHECK(ds.cells(0).size() == 3);
+        CHECK(ds.cells(2).size() == 3);
+    }
+}
+
+TEST_CASE("dataset/column projection", "")
+{
+    using cdmh::data_processing::dataset;
+    using cdmh::data_processing::column_projection;
+    char const *data =
+        "id,title,body,tags\n"
+        "1,first,\"a long, \"\"quoted\"\"\nbody\",x y\n"
+        "2,second,,z\n";
+
+    SECTION("by name") {
+        std::vector<std::string> names;
+        names.push_back("tags");
+        names.push_back("title");
+
+        dataset ds;
+        ds.attach(data, data + strlen(data), column_projection(names));
+        REQUIRE(ds.columns() == 2);
+        REQUIRE(ds.rows() == 2);
+        CHECK(ds.column_title(0) == "tags");
+        CHECK(ds.column_title(1) == "title");
+        CHECK(ds[0][0].get<std::string>() == "x y");
+        CHECK(ds[0][1].get<std::string>() == "first");
+        CHECK(ds[1][0].get<std::string>() == "z");
+    }
+
+    SECTION("by index") {
+        std::vector<size_t> indices;
+        indices.push_back(0);
+        indices.push_back(3);
+
+        dataset ds;
+        ds.attach(data, data + strlen(data), column_projection(indices));
+        REQUIRE(ds.columns() == 2);
+        REQUIRE(ds.rows() == 2);
+        CHECK(ds.column_type(0) == integer_type);
+        CHECK(ds[1][0].get<std::uint32_t>() == 2);
+        CHECK(ds[1][1].get<std::string>() == "z");
+    }
+
+    SECTION("unknown column") {
+        dataset ds;
+        CHECK_THROWS_AS(ds.attach(data, data + strlen(data), column_projection(std::vector<std::string>(1, "missing"))), dataset::invalid_column_name);
+    }
+}
+
+TEST_CASE("dataset/native numeric values", "")
+{
+    char const *data =
+        "id,count,score,mixed\n"
+        "1,,,1\n"
+        "2,-40,2.5,2.5\n"
+        "3,7,,3\n"
+        "4,9000000000,-0.5,\n";
+
+    cdmh::data_processing::dataset ds;
+    ds.attach(data);
+    REQUIRE(ds.rows() == 4);
+    CHECK(ds.column(1).is_integer());
+    CHECK(ds.column(2).is_double());
+    CHECK(ds.column(3).is_string());
+
+    // the leading null is stored before the column type is known
+    CHECK(ds.column(1).sum<std::int64_t>() == 8999999967LL);
+    CHECK(ds.column(1).min<std::int64_t>() == -40);
+    CHECK(ds.column(1).max<std::int64_t>() == 9000000000LL);
+    CHECK(ds.column(1).count_unique<std::int64_t>() == 3);
+    CHECK(ds.column(2).sum<double>() == 2.0);
+    CHECK(ds.column(2).mean() == 1.0);
+    CHECK(ds.column(2).min<double>() == -0.5);
+    CHECK(ds.column(2).extract<double>() == std::vector<double>({ 2.5, -0.5 }));
+
+    // a numeric column can be read as text
+    CHECK(ds.column(1).extract<std::string>() == std::vector<std::string>({ "-40", "7", "9000000000" }));
+    CHECK(ds.extract_column<std::string>(2) == std::vector<std::string>({ "2.5", "-0.5" }));
+
+    SECTION("lazy") {
+        cdmh::data_processing::dataset lazy;
+        lazy.attach_lazy(data, data + strlen(data));
+        CHECK(lazy.column(1).sum<std::int64_t>() == 8999999967LL);
+        CHECK(lazy.column(2).mean() == 1.0);
+    }
+
+    SECTION("integer out of range") {
+        // an integer that doesn't fit in 64 bits makes the column a
+        // string column, rather than being stored as zero
+        char const *data = "a,b\n1,2\n99999999999999999999,3\n-5,4\n";
+        cdmh::data_processing::dataset ds;
+        ds.attach(data);
+        REQUIRE(ds.rows() == 3);
+        CHECK(ds.column(0).is_string());
+        CHECK(ds.column(1).is_integer());
+        CHECK(ds[1][0].get<std::string>() == "99999999999999999999");
+        CHECK(ds.column(1).sum<std::int64_t>() == 9);
+
+        cdmh::data_processing::dataset statistics;
+        statistics.collect_statistics();
+        statistics.attach(data);
+        CHECK(statistics.column(0).is_string());
+        CHECK(statistics.column(0).count() == 3);
+
+        cdmh::data_processing::dataset lazy;
+        lazy.attach_lazy(data, data + strlen(data));
+        CHECK(lazy.column(0).is_string());
+        CHECK(lazy.column(1).sum<std::int64_t>() == 9);
+    }
+}
+
+TEST_CASE("dataset/null bitmap", "")
+{
+    // every third value is null, across several words of the bitmap
+    std::string data("id,value\n");
+    for (int loop=0; loop<200; ++loop)
+        data += std::to_string(loop) + "," + ((loop % 3 == 0)? "" : std::to_string(loop)) + "\n";
+
+    cdmh::data_processing::dataset ds;
+    ds.attach(data.c_str());
+    REQUIRE(ds.rows() == 200);
+    CHECK(ds.column(1).count() == 133);
+    CHECK(ds.column(1).count_null() == 67);
+    CHECK(ds.column(1).min<std::int64_t>() == 1);
+    CHECK(ds.column(1).max<std::int64_t>() == 199);
+    CHECK(ds.column(1).extract<std::int64_t>().size() == 133);
+    CHECK(ds.column(0).count_null() == 0);
+
+    SECTION("append") {
+        using cdmh::data_processing::detail::append_bits;
+        using cdmh::data_processing::detail::push_bit;
+        using cdmh::data_processing::detail::test_bit;
+
+        std::vector<std::uint64_t> bits, other;
+        for (size_t loop=0; loop<70; ++loop)
+            push_bit(bits, loop, loop % 2 == 0);
+        for (size_t loop=0; loop<130; ++loop)
+            push_bit(other, loop, loop % 5 == 0);
+
+        append_bits(bits, 70, other, 130);
+        REQUIRE(bits.size() == 4);
+        for (size_t loop=0; loop<200; ++loop)
+            CHECK(test_bit(bits, loop) == ((loop < 70)? loop % 2 == 0 : (loop - 70) % 5 == 0));
+    }
+}
+
+TEST_CASE("dataset/dictionary encoding", "")
+{
+    char const *data =
+        "id,tag,score\n"
+        "1,red,1.5\n"
+        "2,Green,2.5\n"
+        "3,red,3.5\n"
+        "4,,4.5\n"
+        "5,blue,5.5\n"
+        "6,RED,6.5\n";
+
+    cdmh::data_processing::dataset ds;
+    ds.attach(data);
+    REQUIRE(ds.rows() == 6);
+
+    // values are compared without case, and the first spelling is kept
+    auto const &dictionary = ds.column(1).dictionary();
+    REQUIRE(dictionary.size() == 3);
+    CHECK(dictionary[0] == "red");
+    CHECK(dictionary[1] == "green");
+    CHECK(dictionary[2] == "blue");
+    CHECK(ds.column(1).codes() == std::vector<std::uint32_t>({ 0, 1, 0, cdmh::data_processing::detail::null_code, 2, 0 }));
+    CHECK(ds.column(1).count_unique() == 3);
+    CHECK(ds.column(1).rows_matching("Red") == std::vector<size_t>({ 0, 2, 5 }));
+    CHECK(ds.column(1).rows_matching("yellow").empty());
+
+    auto const counts = ds.column(1).value_counts();
+    REQUIRE(counts.size() == 3);
+    CHECK(counts[0].second == 3);
+    CHECK(counts[1].second == 1);
+    CHECK(counts[2].second == 1);
+
+    // numeric columns aren't encoded
+    CHECK(ds.column(2).codes().empty());
+    CHECK(ds.column(2).rows_matching("2.5") == std::vector<size_t>({ 1 }));
+
+    SECTION("high cardinality") {
+        std::string data("id,name\n");
+        for (size_t loop=0; loop<cdmh::data_processing::detail::max_dictionary_size + 10; ++loop)
+            data += std::to_string(loop) + ",name" + std::to_string(loop) + "\n";
+
+        cdmh::data_processing::dataset ds;
+        ds.attach(data.c_str());
+        CHECK(ds.column(1).codes().empty());
+        CHECK(ds.column(1).dictionary().empty());
+        CHECK(ds.column(1).count_unique() == ds.rows());
+        CHECK(ds.column(1).rows_matching("NAME42") == std::vector<size_t>({ 42 }));
+        CHECK(ds.column(1).value_counts().size() == ds.rows());
+    }
+}
+
+TEST_CASE("dataset/compact cells", "")
+{
+    using cdmh::data_processing::string_view;
+    typedef cdmh::data_processing::dataset::cell_list_t cell_list_t;
+
+    char const buffer[] = "alpha,beta,gamma";
+    cell_list_t cells;
+    cells.push_back(string_view(buffer + 6, buffer + 10));
+    cells.push_back(string_view(""));
+
+    // a value before the first value moves the base
+    cells.push_back(string_view(buffer, buffer + 5));
+    REQUIRE(cells.size() == 3);
+    CHECK(cells[0].get<std::string>() == "beta");
+    CHECK(cells[1].is_null());
+    CHECK(cells[2].get<std::string>() == "alpha");
+    CHECK(!cells.is_wide());
+
+    // a value that is elsewhere, such as in the arena
+    std::string const elsewhere("delta");
+    cells.set(1, elsewhere);
+    CHECK(cells[1].get<std::string>() == "delta");
+
+    // the cells of another list are moved to this base if they can be,
+    // otherwise the list is widened
+    cell_list_t other;
+    other.push_back(string_view(buffer + 11, buffer + 16));
+    other.push_back(elsewhere);
+    cells.append(other);
+    REQUIRE(cells.size() == 5);
+    CHECK(cells[3].get<std::string>() == "gamma");
+    CHECK(cells[4].get<std::string>() == "delta");
+    CHECK(cells[0].get<std::string>() == "beta");
+    CHECK(cells[1].get<std::string>() == "delta");
+
+    // the values elsewhere of another list are added to those of this list
+    std::string const epsilon("epsilon");
+    cell_list_t more;
+    more.push_back(string_view(buffer, buffer + 5));
+    more.push_back(string_view(buffer + 6, buffer + 10));
+    more.set(1, epsilon);
+    cells.append(more);
+    REQUIRE(cells.size() == 7);
+    CHECK(!cells.is_wide());
+    CHECK(cells[5].get<std::string>() == "alpha");
+    CHECK(cells[6].get<std::string>() == "epsilon");
+    CHECK(cells[1].get<std::string>() == "delta");
+
+    std::vector<std::string> values;
+    for (auto const &cell : cells)
+        values.push_back(cell.get<std::string>());
+    CHECK(values == std::vector<std::string>({ "beta", "delta", "alpha", "gamma", "delta", "alpha", "epsilon" }));
+
+    cells.clear();
+    CHECK(cells.empty());
+    CHECK(!cells.is_wide());
+}
+
+TEST_CASE("dataset/row estimate", "")
+{
+    std::string data("id,name,value\n");
+    for (int loop=0; loop<5000; ++loop)
+        data += std::to_string(loop) + ",\"name " + std::to_string(loop % 97) + "\"," + std::to_string(loop * 3) + "\n";
+
+    auto const estimate = cdmh::data_processing::detail::estimate_records(data.data(), data.data() + data.length());
+    CHECK(estimate > 4500);
+    CHECK(estimate < 5500);
+    CHECK(cdmh::data_processing::detail::estimate_records(data.data(), data.data()) == 0);
+
+    cdmh::data_processing::dataset ds;
+    char const *begin = data.data();
+    ds.attach(begin, begin + data.length());
+    CHECK(ds.rows() == 5000);
+    CHECK(ds.column(2).sum<std::int64_t>() == 3 * 4999 * 5000 / 2);
+}
+
+TEST_CASE("dataset/segmented storage", "")
+{
+    cdmh::data_processing::detail::segmented_vector<int> values;
+    for (int loop=0; loop<1000; ++loop)
+        values.push_back(loop);
+    REQUIRE(values.size() == 1000);
+    CHECK(values.capacity() >= 1000);
+
+    // elements never move as the vector grows
+    int const *first = &values[0];
+    for (int loop=1000; loop<5000; ++loop)
+        values.push_back(loop);
+    CHECK(&values[0] == first);
+
+    bool in_order = true;
+    for (int loop=0; loop<5000; ++loop)
+        in_order = in_order  &&  values[loop] == loop;
+    CHECK(in_order);
+
+    auto const copy(values);
+    REQUIRE(copy.size() == 5000);
+    CHECK(copy[4999] == 4999);
+
+    // storage is kept when the vector is cleared
+    auto const capacity = values.capacity();
+    values.clear();
+    CHECK(values.empty());
+    CHECK(values.capacity() == capacity);
+}
+
+TEST_CASE("dataset/escaped quotes", "")
+{
+    char const *data =
+        "id,text\n"
+        "1,\"say \"\"hello\"\"\"\n"
+        "2,\"plain\"\n"
+        "3,\"\"\"\"\"\"\n";
+
+    cdmh::data_processing::dataset ds;
+    ds.attach(data);
+    REQUIRE(ds.rows() == 3);
+
+    // values without escapes still refer to the attached buffer
+    auto const plain = ds[1][1].get<cdmh::data_processing::string_view>();
+    CHECK(plain.begin() == strstr(data, "plain"));
+
+    CHECK(ds[0][1].get<std::string>() == "say \"hello\"");
+    CHECK(ds[2][1].get<std::string>() == "\"\"");
+    CHECK(ds.column(1).is_string());
+
+    std::ostringstream stream;
+    stream << ds[0];
+    CHECK(stream.str() == "1,\"say \"\"hello\"\"\"");
+
+    SECTION("cell") {
+        std::ostringstream cell;
+        cell << ds[2][1];
+        CHECK(cell.str() == "\"\"\"\"\"\"");
+    }
+
+    SECTION("dialect quote") {
+        cdmh::data_processing::dataset quoted;
+        quoted.attach<cdmh::data_processing::dialect<',', '\''>>("id,text\n1,'it''s \"so\"'\n");
+        REQUIRE(quoted.rows() == 1);
+        CHECK(quoted[0][1].get<std::string>() == "it's \"so\"");
+
+        std::ostringstream output;
+        output << quoted;
+        CHECK(output.str() == "'id','text'\n1,'it''s \"so\"'\n");
+    }
+
+    SECTION("parallel") {
+        cdmh::data_processing::dataset parallel;
+        parallel.attach_parallel(data, data + strlen(data), 2);
+        CHECK(parallel[0][1].get<std::string>() == "say \"hello\"");
+        CHECK(parallel[2][1].get<std::string>() == "\"\"");
+    }
+}
+
+TEST_CASE("dataset/lazy attach", "")
+{
+    char const *data =
+        "id,text,score\r\n"
+        "1,\"two\r\nlines\",2.5\r\n"
+        "\r\n"
+        "2,\"a \"\"quote\"\"\"\r\n"
+        "3,plain,4.5\r\n";
+
+    cdmh::data_processing::dataset ds;
+    ds.attach_lazy(data, data + strlen(data));
+    REQUIRE(ds.columns() == 3);
+    REQUIRE(ds.rows() == 3);
+
+    SECTION("row access") {
+        CHECK(ds[1][0].get<std::uint32_t>() == 2);
+        CHECK(ds[1][1].get<std::string>() == "a \"quote\"");
+        CHECK(ds[1][2].is_null());
+        CHECK(ds[0][1].get<std::string>() == "two\r\nlines");
+
+        // a value that isn't escaped refers to the buffer, so remains
+        // valid when other rows are decoded
+        auto const plain = ds[2][1].get<cdmh::data_processing::string_view>();
+        CHECK(ds[1][1].get<std::string>() == "a \"quote\"");
+        CHECK(ds[0][2].get<double>() == 2.5);
+        CHECK(std::string(plain.begin(), plain.end()) == "plain");
+        CHECK(ds[1][0].get<std::uint32_t>() == 2);
+    }
+
+    SECTION("rereading escaped rows") {
+        // an unescaped value is held by the cached row, and the storage
+        // is reused for the next row, so rereading rows doesn't allocate
+        std::set<char const *> values;
+        for (int loop=0; loop<1000; ++loop)
+        {
+            auto const quote = ds[1][1].get<cdmh::data_processing::string_view>();
+            CHECK(std::string(quote.begin(), quote.end()) == "a \"quote\"");
+            values.insert(quote.begin());
+            CHECK(ds[0][1].get<std::string>() == "two\r\nlines");
+        }
+        CHECK(values.size() == 1);
+    }
+
+    SECTION("column access") {
+        CHECK(ds.column_type(2) == double_type);
+        CHECK(ds.column(2).count() == 2);
+        CHECK(ds.column(2).sum<double>() == 7.0);
+        CHECK(ds[2][2].get<double>() == 4.5);
+        CHECK(ds.column(0).is_integer());
+    }
+
+    SECTION("erase column") {
+        ds.erase_column(0);
+        REQUIRE(ds.columns() == 2);
+        CHECK(ds[2][0].get<std::string>() == "plain");
+        CHECK(ds.column(1).count_null() == 1);
+    }
+}
+
+TEST_CASE("dataset/attach row range", "")
+{
+    // large enough to be indexed in several chunks
+    std::ostringstream stream;
+    stream << "id,text\n";
+    for (int loop=0; loop<20000; ++loop)
+        stream << loop << ",\"line\n" << loop << ", \"\"quoted\"\"\"\n";
+    auto const data = stream.str();
+
+    cdmh::data_processing::record_index index(data.c_str(), data.c_str() + data.length(), 7);
+    REQUIRE(index.size() == 20000);
+
+    cdmh::data_processing::dataset ds;
+    ds.attach_rows(index, 15000, 15100);
+    REQUIRE(ds.columns() == 2);
+    REQUIRE(ds.rows() == 100);
+    CHECK(ds.column_title(1) == "text");
+    CHECK(ds[0][0].get<std::uint32_t>() == 15000);
+    CHECK(ds[99][0].get<std::uint32_t>() == 15099);
+    CHECK(ds[99][1].get<std::string>() == "line\n15099, \"quoted\"");
+
+    cdmh::data_processing::dataset tail;
+    tail.attach_rows(index, 19990, index.size());
+    CHECK(tail.rows() == 10);
+    CHECK(tail[9][0].get<std::uint32_t>() == 19999);
+
+    cdmh::data_processing::dataset ds2;
+    CHECK_THROWS_AS(ds2.attach_rows(index, 0, 20001), std::out_of_range);
+}
+
+TEST_CASE("dataset/attach files", "")
+{
+    std::vector<std::string> filenames;
+    for (int file=0; file<3; ++file)
+    {
+        filenames.push_back("part" + std::to_string(file) + ".csv");
+        std::ofstream f(filenames.back());
+        f << "id,value\n";
+        for (int loop=0; loop<100; ++loop)
+            f << file * 100 + loop << ',' << ((file == 1)? "1.5" : "2") << "\n";
+    }
+
+    SECTION("matching headers") {
+        cdmh::data_processing::dataset ds;
+        REQUIRE(ds.attach_files(filenames, 2));
+        REQUIRE(ds.columns() == 2);
+        REQUIRE(ds.rows() == 300);
+        CHECK(ds.column_title(1) == "value");
+        CHECK(ds[150][0].get<std::uint32_t>() == 150);
+        CHECK(ds[299][0].get<std::uint32_t>() == 299);
+        CHECK(ds.column(0).is_integer());
+        CHECK(ds.column(1).is_string());     // integer and double values
+    }
+
+    SECTION("mismatched headers") {
+        std::ofstream("part2.csv") << "id,other\n1,2\n";
+        cdmh::data_processing::dataset ds;
+        CHECK_THROWS_AS(ds.attach_files(filenames), cdmh::data_processing::dataset::header_mismatch);
+    }
+
+    SECTION("missing file") {
+        filenames.push_back("missing.csv");
+        cdmh::data_processing::dataset ds;
+        CHECK(!ds.attach_files(filenames));
+    }
+
+    for (auto const &filename : filenames)
+        std::remove(filename.c_str());
+}
+
+TEST_CASE("dataset/snapshot", "")
+{
+    char const *data =
+        "id,name,score,note\n"
+        "1,alpha,1.5,\"say \"\"hi\"\"\"\n"
+        "2,beta,,\n"
+        "3,alpha,-2.25,plain\n";
+
+    cdmh::data_processing::dataset ds;
+    ds.attach(data);
+    ds.save_snapshot("snapshot.dps");
+
+    std::ostringstream expected;
+    expected << ds;
+
+    SECTION("round trip") {
+        cdmh::data_processing::dataset snapshot;
+        REQUIRE(snapshot.open_snapshot("snapshot.dps"));
+        REQUIRE(snapshot.columns() == 4);
+        REQUIRE(snapshot.rows() == 3);
+        CHECK(snapshot.column_title(2) == "score");
+        CHECK(snapshot.column(0).is_integer());
+        CHECK(snapshot.column(1).is_string());
+        CHECK(snapshot.column(2).is_double());
+        CHECK(snapshot.column(0).sum<std::int64_t>() == 6);
+        CHECK(snapshot.column(2).sum<double>() == -0.75);
+        CHECK(snapshot.column(2).count_null() == 1);
+        CHECK(snapshot.column(3).count_null() == 1);
+        CHECK(snapshot.column(1).count_unique() == 2);
+        CHECK(snapshot.cell(0, 3).get<std::string>() == "say \"hi\"");
+        CHECK(snapshot[2][1].get<std::string>() == "alpha");
+
+        std::ostringstream actual;
+        actual << snapshot;
+        CHECK(actual.str() == expected.str());
+    }
+
+    SECTION("invalid cells") {
+        std::vector<cdmh::data_processing::column_schema> schema;
+        schema.push_back(cdmh::data_processing::column_schema("id", integer_type));
+        schema.push_back(cdmh::data_processing::column_schema("name", string_type));
+        schema.push_back(cdmh::data_processing::column_schema("score", integer_type));
+        schema.push_back(cdmh::data_processing::column_schema("note", string_type));
+
+        cdmh::data_processing::dataset typed;
+        char const *begin = data;
+        typed.attach(begin, begin + strlen(data), schema);
+        REQUIRE(typed.invalid_cells().size() == 2);
+        typed.save_snapshot("snapshot.dps");
+
+        cdmh::data_processing::dataset snapshot;
+        REQUIRE(snapshot.open_snapshot("snapshot.dps"));
+        CHECK(snapshot.invalid_cells() == typed.invalid_cells());
+
+        // an invalid cell that is beyond the last row
+        std::string file;
+        {
+            std::ifstream in("snapshot.dps", std::ios::binary);
+            file.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        cdmh::data_processing::detail::snapshot_header header;
+        memcpy(&header, file.data(), sizeof(header));
+        std::uint64_t const row = header.rows;
+        file.replace(size_t(header.invalid_cells_offset), sizeof(row), reinterpret_cast<char const *>(&row), sizeof(row));
+        std::ofstream("snapshot.dps", std::ios::binary | std::ios::trunc) << file;
+
+        cdmh::data_processing::dataset corrupt;
+        CHECK_THROWS_AS(corrupt.open_snapshot("snapshot.dps"), cdmh::data_processing::dataset::invalid_snapshot);
+        CHECK(!corrupt.is_attached());
+        CHECK(corrupt.invalid_cells().empty());
+    }
+
+    SECTION("invalid file") {
+        std::ofstream("snapshot.dps") << "id,name\n1,2\n";
+        cdmh::data_processing::dataset snapshot;
+        CHECK_THROWS_AS(snapshot.open_snapshot("snapshot.dps"), cdmh::data_processing::dataset::invalid_snapshot);
+    }
+
+    SECTION("corrupt cells") {
+        std::string file;
+        {
+            std::ifstream in("snapshot.dps", std::ios::binary);
+            file.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        cdmh::data_processing::detail::snapshot_header header;
+        cdmh::data_processing::detail::snapshot_column column;
+        memcpy(&header, file.data(), sizeof(header));
+        memcpy(&column, file.data() + header.directory_offset + sizeof(column), sizeof(column));
+        REQUIRE(column.cell_width == 8);
+
+        // a cell of the name column that extends beyond its heap
+        std::uint32_t const length = std::uint32_t(column.heap_length);
+        file.replace(size_t(column.cells_offset + sizeof(std::uint32_t)), sizeof(length), reinterpret_cast<char const *>(&length), sizeof(length));
+        std::ofstream("snapshot.dps", std::ios::binary | std::ios::trunc) << file;
+
+        cdmh::data_processing::dataset snapshot;
+        CHECK_THROWS_AS(snapshot.open_snapshot("snapshot.dps"), cdmh::data_processing::dataset::invalid_snapshot);
+
+        // the columns read before the corrupt cell are removed, so the
+        // dataset can open another snapshot
+        CHECK(!snapshot.is_attached());
+        CHECK(snapshot.columns() == 0);
+        ds.save_snapshot("snapshot.dps");
+        REQUIRE(snapshot.open_snapshot("snapshot.dps"));
+        REQUIRE(snapshot.columns() == 4);
+        CHECK(snapshot.rows() == 3);
+        CHECK(snapshot[1][1].get<std::string>() == "beta");
+    }
+
+    SECTION("corrupt directory") {
+        std::string saved;
+        {
+            std::ifstream in("snapshot.dps", std::ios::binary);
+            saved.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        cdmh::data_processing::detail::snapshot_header header;
+        memcpy(&header, saved.data(), sizeof(header));
+
+        // replace the native offset of a column in the directory
+        auto const open_with_native_offset = [&saved, &header](size_t index, std::uint64_t native_offset) {
+            std::string file(saved);
+            cdmh::data_processing::detail::snapshot_column column;
+            size_t const entry = size_t(header.directory_offset + index * sizeof(column));
+            memcpy(&column, file.data() + entry, sizeof(column));
+            column.native_offset = native_offset;
+            file.replace(entry, sizeof(column), reinterpret_cast<char const *>(&column), sizeof(column));
+            std::ofstream("snapshot.dps", std::ios::binary | std::ios::trunc) << file;
+
+            cdmh::data_processing::dataset snapshot;
+            return snapshot.open_snapshot("snapshot.dps");
+        };
+
+        // a numeric column with values that has no native values
+        CHECK_THROWS_AS(open_with_native_offset(2, 0), cdmh::data_processing::dataset::invalid_snapshot);
+
+        // a string column with native values
+        CHECK_THROWS_AS(open_with_native_offset(1, header.directory_offset), cdmh::data_processing::dataset::invalid_snapshot);
+    }
+
+    SECTION("missing file") {
+        cdmh::data_processing::dataset snapshot;
+        CHECK(!snapshot.open_snapshot("missing.dps"));
+    }
+
+    std::remove("snapshot.dps");
+}
+
+TEST_CASE("dataset/column statistics", "")
+{
+    char const *data =
+        "count,price\n"
+        "4,2.5\n"
+        "-3,\n"
+        "4,0.5\n"
+        ",2.5\n"
+        "9,4.5\n"
+        "-3,2.5\n";
+
+    cdmh::data_processing::dataset ds;
+    ds.attach(data);
+    REQUIRE(ds.column(0).is_integer());
+    REQUIRE(ds.column(1).is_double());
+
+    // the statistics are the same when the sorted values are reused
+    for (int loop=0; loop<2; ++loop)
+    {
+        CHECK(ds.column(0).mean() == 11.0 / 5.0);
+        CHECK(ds.column(0).median() == 4.0);
+        CHECK(ds.column(0).mode() == -3.0);
+        CHECK(fabs(ds.column(0).standard_deviation() - 4.6217) < 0.0001);
+        CHECK(ds.column(1).mean() == 2.5);
+        CHECK(ds.column(1).median() == 2.5);
+        CHECK(ds.column(1).mode() == 2.5);
+        CHECK(fabs(ds.column(1).standard_deviation() - 1.2649) < 0.0001);
+    }
+
+    CHECK(cdmh::data_processing::maths::sorted_median(std::vector<int>{1, 2, 3}) == 2);
+    CHECK(cdmh::data_processing::maths::sorted_mode(std::vector<int>{1, 1, 2, 2, 2, 3}) == 2);
+    CHECK_THROWS_AS(cdmh::data_processing::maths::sorted_mode(std::vector<int>{1, 2, 3}), cdmh::data_processing::maths::math_error);
+    CHECK_THROWS_AS(cdmh::data_processing::maths::sorted_median(std::vector<int>()), cdmh::data_processing::maths::math_error);
+}
+
+TEST_CASE("dataset/ingest statistics", "")
+{
+    std::ostringstream stream;
+    stream << "id,count,price,name\n" << std::fixed << std::setprecision(2);
+    for (int row=0; row<5000; ++row)
+    {
+        stream << row << ',';
+        if (row % 7)
+            stream << (row % 101) - 50;
+        stream << ',';
+        if (row % 5)
+            stream << (row % 13) * -0.25;
+        stream << ",name" << (row % 3) << "\n";
+    }
+    auto const csv = stream.str();
+    char const *const begin = csv.data();
+    char const *const end   = begin + csv.length();
+
+    cdmh::data_processing::dataset scanned;
+    scanned.attach(begin, end);
+
+    // the statistics are the same as those found by reading the columns
+    auto same_statistics = [&scanned](cdmh::data_processing::dataset const &ds, size_t column, size_t scanned_column) {
+        auto const actual   = ds.column(column);
+        auto const expected = scanned.column(scanned_column);
+        return actual.count() == expected.count()
+           &&  actual.count_null() == expected.count_null()
+           &&  (actual.is_string()
+           ||  (actual.min<double>() == expected.min<double>()
+           &&   actual.max<double>() == expected.max<double>()
+           &&   actual.sum<double>() == expected.sum<double>()
+           &&   actual.sum_of_squares() == expected.sum_of_squares()));
+    };
+
+    SECTION("attach") {
+        cdmh::data_processing::dataset ds;
+        ds.collect_statistics();
+        ds.attach(begin, end);
+        for (size_t column=0; column<ds.columns(); ++column)
+            CHECK(same_statistics(ds, column, column));
+        CHECK(ds.column(1).min<std::int64_t>() == -50);
+        CHECK(ds.column(1).max<std::int64_t>() == 50);
+        CHECK(ds.column(2).max<double>() == 0.0);
+        CHECK(ds.column(2).min<double>() == -3.0);
+        CHECK(ds.column(1).count_null() == 715);
+
+        ds.erase_column(1);
+        REQUIRE(ds.columns() == 3);
+        CHECK(ds.column_title(1) == "price");
+        CHECK(ds.column(1).is_double());
+        CHECK(same_statistics(ds, 1, 2));
+        CHECK(same_statistics(ds, 2, 3));
+    }
+
+    SECTION("parallel attach") {
+        cdmh::data_processing::dataset ds;
+        ds.collect_statistics();
+        ds.attach_parallel(begin, end, 4);
+        for (size_t column=0; column<ds.columns(); ++column)
+            CHECK(same_statistics(ds, column, column));
+    }
+
+    SECTION("integer overflow") {
+        char const *data =
+            "count\n"
+            "9223372036854775807\n"
+            "1\n"
+            "9223372036854775807\n";
+
+        // the sum wraps, as it does without statistics
+        cdmh::data_processing::dataset ds;
+        ds.collect_statistics();
+        ds.attach(data);
+        cdmh::data_processing::dataset unsummarised;
+        unsummarised.attach(data);
+        CHECK(ds.column(0).sum<std::int64_t>() == unsummarised.column(0).sum<std::int64_t>());
+        CHECK(ds.column(0).sum<std::int64_t>() == -1);
+    }
+
+    SECTION("lazy attach") {
+        cdmh::data_processing::dataset ds;
+        ds.collect_statistics();
+        ds.attach_lazy(begin, end);
+        for (size_t column=0; column<ds.columns(); ++column)
+            CHECK(same_statistics(ds, column, column));
+    }
+
+    SECTION("schema") {
+        std::vector<cdmh::data_processing::column_schema> schema;
+        schema.push_back(cdmh::data_processing::column_schema("id", integer_type));
+        schema.push_back(cdmh::data_processing::column_schema("count", integer_type));
+        schema.push_back(cdmh::data_processing::column_schema("price", double_type));
+        schema.push_back(cdmh::data_processing::column_schema("name", string_type));
+
+        cdmh::data_processing::dataset ds;
+        ds.collect_statistics();
+        ds.attach(begin, end, schema);
+        for (size_t column=0; column<ds.columns(); ++column)
+            CHECK(same_statistics(ds, column, column));
+    }
+}
+
+TEST_CASE("dataset/describe", "")
+{
+    std::ostringstream stream;
+    stream << "id,name,reading,offset\n";
+    for (int row=0; row<3000; ++row)
+    {
+        stream << row << ",name" << row % 7 << ',';
+        if (row % 9)
+            stream << (row % 17) - 8.5;
+        // a large offset loses precision if the squares of the values
+        // are summed
+        stream << ',' << 1000000000 + (row % 5) << "\n";
+    }
+    auto const csv = stream.str();
+
+    cdmh::data_processing::dataset ds;
+    ds.attach(csv.data(), csv.data() + csv.length());
+    auto const summary = ds.describe(4);
+    REQUIRE(summary.size() == 3);
+    CHECK(summary[0].name == "id");
+    CHECK(summary[1].name == "reading");
+    CHECK(summary[2].name == "offset");
+    CHECK(summary[1].type == double_type);
+
+    size_t const columns[] = { 0, 2, 3 };
+    for (size_t loop=0; loop<3; ++loop)
+    {
+        auto const column = ds.column(columns[loop]);
+        CHECK(summary[loop].count == column.count());
+        CHECK(summary[loop].count_null == column.count_null());
+        CHECK(summary[loop].min == column.min<double>());
+        CHECK(summary[loop].max == column.max<double>());
+        CHECK(fabs(summary[loop].mean - column.mean()) < 1e-9);
+        CHECK(fabs(summary[loop].standard_deviation - column.standard_deviation()) < 1e-9);
+    }
+    CHECK(fabs(summary[2].standard_deviation - sqrt(2.0)) < 1e-9);
+
+    // the same summary is returned by a single thread
+    auto const serial = ds.describe(1);
+    CHECK(serial[1].mean == summary[1].mean);
+
+    SECTION("column without values") {
+        std::vector<cdmh::data_processing::column_schema> schema;
+        schema.push_back(cdmh::data_processing::column_schema("id", integer_type));
+        schema.push_back(cdmh::data_processing::column_schema("score", double_type));
+
+        cdmh::data_processing::dataset empty;
+        char const *data = "id,score\n1,\n2,\n";
+        empty.attach(data, data + strlen(data), schema);
+        auto const summary = empty.describe();
+        REQUIRE(summary.size() == 2);
+        CHECK(summary[1].count == 0);
+        CHECK(summary[1].count_null == 2);
+        CHECK(summary[1].mean != summary[1].mean);
+    }
+}
+
+TEST_CASE("dataset/reduction kernels", "")
+{
+    using namespace cdmh::data_processing::detail;
+
+    std::mt19937_64 generator(25);
+    size_t const lengths[] = { 0, 1, 3, 15, 16, 17, 63, 64, 65, 127, 1000, 4099 };
+    for (auto length : lengths)
+    {
+        // every third word of the null bitmap has every bit set, so the
+        // vector loops of each kernel are used, and the rest are random
+        size_t const words = (length + 63) / 64;
+        std::vector<std::uint64_t> valid(words);
+        std::vector<std::int64_t>  integers(length);
+        std::vector<double>        doubles(length);
+        for (size_t word=0; word<words; ++word)
+            valid[word] = (word % 3 == 0)? ~std::uint64_t(0) : generator();
+        if (length % 64)
+            valid.back() &= (std::uint64_t(1) << (length % 64)) - 1;
+        for (size_t row=0; row<length; ++row)
+        {
+            bool const is_valid = (valid[row / 64] & (std::uint64_t(1) << (row % 64))) != 0;
+            integers[row] = is_valid? std::int64_t(generator() % 2000001) - 1000000 : 0;
+            doubles[row]  = is_valid? double(integers[row]) / 7.0 : 0.0;
+        }
+
+        std::int64_t const integer_sum = reduce_sum(integers.data(), length, scalar_kernels);
+        double       const double_sum  = reduce_sum(doubles.data(), length, scalar_kernels);
+        double       const squares     = reduce_sum_of_squares(doubles.data(), length, scalar_kernels);
+        size_t       const count       = count_set_bits(valid.data(), words, scalar_kernels);
+        CHECK(integer_sum == std::accumulate(integers.begin(), integers.end(), std::int64_t()));
+        CHECK(fabs(double_sum - std::accumulate(doubles.begin(), doubles.end(), 0.0)) < 1e-6);
+
+        std::int64_t integer_min, integer_max;
+        double       double_min,  double_max;
+        bool const has_values = reduce_min_max(integers.data(), valid.data(), words, integer_min, integer_max, scalar_kernels);
+        CHECK(has_values == (count > 0));
+        reduce_min_max(doubles.data(), valid.data(), words, double_min, double_max, scalar_kernels);
+
+        // each kernel returns the same results as the scalar kernels,
+        // including the sums of doubles
+        for (int level=scalar_kernels; level<=supported_simd_level(); ++level)
+        {
+            auto const kernels = simd_level(level);
+            CHECK(reduce_sum(integers.data(), length, kernels) == integer_sum);
+            CHECK(reduce_sum(doubles.data(), length, kernels) == double_sum);
+            CHECK(reduce_sum_of_squares(doubles.data(), length, kernels) == squares);
+            CHECK(fabs(reduce_sum_of_squares(integers.data(), length, kernels) - squares * 49.0) <= squares * 49.0 * 1e-12);
+            CHECK(count_set_bits(valid.data(), words, kernels) == count);
+
+            std::int64_t min, max;
+            double       dmin, dmax;
+            CHECK(reduce_min_max(integers.data(), valid.data(), words, min, max, kernels) == has_values);
+            CHECK(reduce_min_max(doubles.data(), valid.data(), words, dmin, dmax, kernels) == has_values);
+            if (has_values)
+            {
+                CHECK(min == integer_min);
+                CHECK(max == integer_max);
+                CHECK(dmin == double_min);
+                CHECK(dmax == double_max);
+            }
+        }
+    }
+
+    SECTION("column reductions") {
+        std::ostringstream stream;
+        stream << "id,reading\n";
+        for (int row=0; row<1000; ++row)
+        {
+            stream << row - 500 << ',';
+            if (row % 7)
+                stream << (row % 13) + 0.25;
+            stream << "\n";
+        }
+        auto const csv = stream.str();
+
+        cdmh::data_processing::dataset ds;
+        ds.attach(csv.data(), csv.data() + csv.length());
+        auto const id      = ds.column(0);
+        auto const reading = ds.column(1);
+        CHECK(id.sum<std::int64_t>() == -500);
+        CHECK(id.min<std::int64_t>() == -500);
+        CHECK(id.max<std::int64_t>() == 499);
+        CHECK(reading.count() == 857);
+        CHECK(reading.min<double>() == 0.25);
+        CHECK(reading.max<double>() == 12.25);
+
+        double sum = 0.0, squares = 0.0;
+        for (int row=0; row<1000; ++row)
+        {
+            if (row % 7)
+            {
+                sum     += (row % 13) + 0.25;
+                squares += ((row % 13) + 0.25) * ((row % 13) + 0.25);
+            }
+        }
+        CHECK(fabs(reading.sum<double>() - sum) < 1e-9);
+        CHECK(fabs(reading.sum_of_squares() - squares) < 1e-6);
+    }
+}
+
+#ifdef DATA_PROCESSING_USE_ZLIB
+TEST_CASE("compressed_reader", "")
+{
+    // small blocks, so that records and quoted line ends span blocks
+    std::ostringstream stream;
+    stream << "id,text\n";
+    for (int loop=0; loop<5000; ++loop)
+        stream << loop << ",\"line\n" << loop << "\"\n";
+    stream << "5000,\"" << std::string(10000, 'x') << "\"\n";
+    auto const data = stream.str();
+
+    gzFile file = gzopen("compressed.csv.gz", "wb");
+    REQUIRE(file != nullptr);
+    gzwrite(file, data.data(), (unsigned)data.length());
+    gzclose(file);
+
+    {
+        cdmh::data_processing::compressed_reader reader("compressed.csv.gz", 4096, 3);
+        size_t groups = 0;
+        std::uint32_t expected_id = 0;
+        while (reader.next())
+        {
+            auto const &group = reader.group();
+            REQUIRE(group.columns() == 2);
+            CHECK(group.column_title(1) == "text");
+            CHECK(reader.first_row() == expected_id);
+            CHECK(group[0][0].get<std::uint32_t>() == expected_id);
+            expected_id += (std::uint32_t)group.rows();
+            ++groups;
+        }
+        CHECK(expected_id == 5001);
+        CHECK(groups > 10);
+    }
+
+    // blocks of blank lines between records have no rows
+    {
+        std::string const blank("id,text\n1,one\n" + std::string(200000, '\n') + "2,two\n");
+        gzFile file = gzopen("compressed.csv.gz", "wb");
+        REQUIRE(file != nullptr);
+        gzwrite(file, blank.data(), (unsigned)blank.length());
+        gzclose(file);
+
+        cdmh::data_processing::compressed_reader reader("compressed.csv.gz", 4096, 3);
+        size_t rows = 0;
+        while (reader.next())
+            rows += reader.group().rows();
+        CHECK(rows == 2);
+
+        file = gzopen("compressed.csv.gz", "wb");
+        REQUIRE(file != nullptr);
+        gzwrite(file, data.data(), (unsigned)data.length());
+        gzclose(file);
+    }
+
+    // a file that ends part of the way through the stream
+    std::string compressed;
+    {
+        std::ifstream in("compressed.csv.gz", std::ios::binary);
+        compressed.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    REQUIRE(compressed.length() > 100);
+    std::ofstream("compressed.csv.gz", std::ios::binary | std::ios::trunc).write(compressed.data(), compressed.length() / 2);
+    CHECK_THROWS_AS(
+        {
+            cdmh::data_processing::compressed_reader reader("compressed.csv.gz", 4096, 3);
+            while (reader.next())
+                ;
+        },
+        std::runtime_error);
+
+    // .z is the extension of pack and compress output, not gzip
+    CHECK_THROWS_AS(cdmh::data_processing::compressed_reader("compressed.csv.z"), std::runtime_error);
+    std::remove("compressed.csv.gz");
+}
+#endif
+
+#ifdef DATA_PROCESSING_USE_ZSTD
+TEST_CASE("compressed_reader/zstd", "")
+{
+    // the file is much smaller than its decompressed data, so the
+    // decoder holds data after the last of the file has been read
+    std::ostringstream stream;
+    stream << "id,text\n";
+    for (int loop=0; loop<5000; ++loop)
+        stream << loop << ",\"line\n" << loop << "\"\n";
+    stream << "5000,\"" << std::string(10000, 'x') << "\"\n";
+    auto const data = stream.str();
+
+    std::vector<char> compressed(ZSTD_compressBound(data.length()));
+    size_t const length = ZSTD_compress(&compressed[0], compressed.size(), data.data(), data.length(), 19);
+    REQUIRE(!ZSTD_isError(length));
+    REQUIRE(length < ZSTD_DStreamInSize());
+    std::ofstream("compressed.csv.zst", std::ios::binary).write(&compressed[0], length);
+
+    {
+        cdmh::data_processing::compressed_reader reader("compressed.csv.zst", 4096, 3);
+        size_t groups = 0;
+        std::uint32_t expected_id = 0;
+        std::string last;
+        while (reader.next())
+        {
+            auto const &group = reader.group();
+            REQUIRE(group.columns() == 2);
+            CHECK(reader.first_row() == expected_id);
+            CHECK(group[0][0].get<std::uint32_t>() == expected_id);
+            expected_id += (std::uint32_t)group.rows();
+            last = group[group.rows() - 1][1].get<std::string>();
+            ++groups;
+        }
+        CHECK(expected_id == 5001);
+        CHECK(groups > 10);
+        CHECK(last == std::string(10000, 'x'));
+    }
+
+    // a file that ends part of the way through a frame
+    std::ofstream("compressed.csv.zst", std::ios::binary | std::ios::trunc).write(&compressed[0], length / 2);
+    CHECK_THROWS_AS(
+        {
+            cdmh::data_processing::compressed_reader reader("compressed.csv.zst", 4096, 3);
+            while (reader.next())
+                ;
+        },
+        std::runtime_error);
+    std::remove("compressed.csv.zst");
+}
+#endif
+
 TEST_CASE("dataset/attach to string")
 {
     char const *data =